@@ -0,0 +1,554 @@
+/*
+	Undo / Redo with bounded memory.
+
+	In 3_text_pad_5.cpp the UndoManager keeps two static stacks of shared_ptr<Command>.
+	 - Every executed command is copied into a new heap object (make_shared<CommandAdd>(*this)).
+	 - The stacks are never trimmed. After a long editing session the history keeps
+	   growing without limit.
+	 - The stacks are static, so all the documents would share one history.
+
+	Now every Application (document) owns its UndoHistory.
+	 - The history does not store Command objects. A command stores a compact EditRecord,
+	   which has exactly the state needed to undo / redo the edit : the kind of edit,
+	   an index, the text and the previous color or boldness.
+	 - The records are moved into a ring buffer, a vector allocated once. No make_shared,
+	   no reference count.
+	 - Undo and redo share the same ring. Records before the cursor can be undone,
+	   records after the cursor can be redone. A new edit discards the redo part.
+	 - The history has a budget : a maximum number of records and a maximum number of bytes
+	   of stored text. When a new record does not fit, the oldest records are dropped.
+	   So the memory used by the history is bounded.
+
+	The commands now only implement Execute(). Undo / Redo of an edit is done by its record.
+
+		_______________			m_OptionsTable	    _______________
+		|     Menu    |---------------------------->|   Command   |
+		---------------								---------------
+																/_\
+																 |
+	_______________	     m_pApp    __________________  	__________________
+	| Application |<---------------| CommandAdd     |  	| CommandUndo    | ...
+	---------------	               ------------------  	------------------
+	 	 |  m_History
+	 	\|/
+	_______________		    ______________
+	| UndoHistory |<>------>| EditRecord |  (ring buffer)
+	---------------		    --------------
+*/
+
+#include <iostream>
+// This will pause the program and prompt the user for input.
+void Message(const std::string &text) {
+	std::cout << "\n----------- " << text << " -----------\n";
+	system(R"(read -p "Press enter to continue!")");
+	system("clear");
+}
+
+
+
+////////////////////////////////////////
+////////////////////  Command.h
+////////////////////////////////////////
+class Command {
+public:
+	virtual void Execute() = 0;
+	virtual ~Command() = default;
+};
+
+
+
+////////////////////////////////////////
+////////////////////  EditRecord.h
+////////////////////////////////////////
+#include "Console.h"
+#include <string>
+#include <cstdint>
+
+class Application;
+
+// The state a command needs to undo / redo one edit.
+struct EditRecord {
+	enum class Kind : uint8_t { Add, Insert, Remove, Overwrite, SetColor, SetBold };
+	Kind m_Kind{};
+	bool m_Bold{};
+	Color m_Color{};
+	size_t m_Index{};
+	std::string m_Text;
+
+	// Bytes charged against the history's budget.
+	size_t TextBytes() const { return m_Text.size(); }
+
+	void Undo(Application &app);
+	void Redo(Application &app);
+};
+
+
+
+////////////////////////////////////////
+////////////////////  	UndoHistory.h
+////////////////////////////////////////
+#include <vector>
+
+class UndoHistory {
+	std::vector<EditRecord> m_Records;	// ring buffer, allocated once
+	size_t m_Begin{};					// oldest record
+	size_t m_Size{};					// records in the ring
+	size_t m_Cursor{};					// [0, m_Cursor) can be undone, [m_Cursor, m_Size) redone
+	size_t m_Bytes{};
+	size_t m_MaxBytes;
+
+	EditRecord& At(size_t i) { return m_Records[(m_Begin + i) % m_Records.size()]; }
+
+	void Free(EditRecord &record) {
+		m_Bytes -= record.TextBytes();
+		std::string{}.swap(record.m_Text);
+	}
+public:
+	// maxRecords == 0 : no history, the edits are not recorded.
+	UndoHistory(size_t maxRecords, size_t maxBytes) : m_Records(maxRecords), m_MaxBytes{maxBytes} {}
+
+	void Add(EditRecord &&record) {
+		if (m_Records.empty()) {
+			return;
+		}
+		// A new edit makes the undone records unreachable.
+		while (m_Size > m_Cursor) {
+			Free(At(--m_Size));
+		}
+		if (record.TextBytes() > m_MaxBytes) {
+			std::cout << "[History] Edit is too large to be undone.\n";
+			// Older records cannot be replayed across this edit.
+			while (m_Size > 0) {
+				Free(At(--m_Size));
+			}
+			m_Cursor = 0;
+			return;
+		}
+		// Drop the oldest records until the new one fits.
+		while (m_Size == m_Records.size() || m_Bytes + record.TextBytes() > m_MaxBytes) {
+			Free(At(0));
+			m_Begin = (m_Begin + 1) % m_Records.size();
+			--m_Size;
+		}
+		m_Bytes += record.TextBytes();
+		At(m_Size++) = std::move(record);
+		m_Cursor = m_Size;
+	}
+
+	bool Undo(Application &app) {
+		if (m_Cursor == 0) return false;
+		At(--m_Cursor).Undo(app);
+		return true;
+	}
+
+	bool Redo(Application &app) {
+		if (m_Cursor == m_Size) return false;
+		At(m_Cursor++).Redo(app);
+		return true;
+	}
+
+	size_t Size() const { return m_Size; }
+	size_t Bytes() const { return m_Bytes; }
+};
+
+
+
+////////////////////////////////////////
+////////////////////  Application.h
+////////////////////////////////////////
+#include <algorithm>
+
+
+
+class Application {
+	std::string m_Text;
+	Color m_Color;
+	bool m_Bold;
+	UndoHistory m_History;
+public:
+	Application(size_t maxUndo = 1000, size_t maxUndoBytes = 1 << 20)
+		: m_Color{Color::DEFAULT}, m_Bold{false}, m_History{maxUndo, maxUndoBytes} {}
+
+	void AddText(const std::string &text) { m_Text += text + " "; }
+	void RemoveText(size_t index, size_t count) { m_Text.erase(index, count); }
+	void OverwriteText(size_t index, const std::string &text) {
+		std::copy(text.begin(), text.end(), m_Text.begin() + index);
+	}
+	void InsertText(size_t index, const std::string &text) { m_Text.insert(index, text); }
+	void SetColor(Color color) { m_Color = color; }
+	void SetBold(bool bold) { m_Bold = bold; }
+	bool IsBold() const { return m_Bold; }
+	Color GetColor() const { return m_Color; }
+	const std::string& GetText() const { return m_Text; }
+	UndoHistory& History() { return m_History; }
+
+	void Display() const { Console::WriteLine(m_Text, m_Color, m_Bold); }
+};
+
+
+////////////////////////////////////
+//////////////////  EditRecord.cpp
+////////////////////////////////////
+void EditRecord::Undo(Application &app) {
+	switch (m_Kind) {
+		case Kind::Add:
+			// 1 is for the ' ' added while adding.
+			app.RemoveText(app.GetText().size() - m_Text.size() - 1, m_Text.size() + 1);
+			break;
+		case Kind::Insert:
+			app.RemoveText(m_Index, m_Text.size());
+			break;
+		case Kind::Remove:
+			app.InsertText(m_Index, m_Text);
+			break;
+		case Kind::Overwrite: {
+			auto text = app.GetText().substr(m_Index, m_Text.size());
+			app.OverwriteText(m_Index, m_Text);
+			m_Text = text; // for redo
+			break;
+		}
+		case Kind::SetColor: {
+			auto color = app.GetColor();
+			app.SetColor(m_Color);
+			m_Color = color;
+			break;
+		}
+		case Kind::SetBold: {
+			auto bold = app.IsBold();
+			app.SetBold(m_Bold);
+			m_Bold = bold;
+			break;
+		}
+	}
+}
+
+void EditRecord::Redo(Application &app) {
+	switch (m_Kind) {
+		case Kind::Add:
+			app.AddText(m_Text);
+			break;
+		case Kind::Insert:
+			app.InsertText(m_Index, m_Text);
+			break;
+		case Kind::Remove:
+			app.RemoveText(m_Index, m_Text.size());
+			break;
+		// These swap the old and the new state, same as undo.
+		case Kind::Overwrite:
+		case Kind::SetColor:
+		case Kind::SetBold:
+			Undo(app);
+			break;
+	}
+}
+
+
+////////////////////////////////////
+//////////////////  CommandDisplay.cpp
+////////////////////////////////////
+class CommandDisplay : public Command {
+	Application *m_pApp;
+public:
+	CommandDisplay(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		m_pApp->Display();
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  CommandAdd.cpp
+////////////////////////////////////
+class CommandAdd : public Command {
+	Application *m_pApp;
+public:
+	CommandAdd(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Add};
+		std::cout << "Enter text to add : ";
+		std::cin.ignore(); // to ignore any remaining characters in the input stream
+						   // required when using getline because getline by default reads till next \n
+		std::getline(std::cin, record.m_Text);
+		m_pApp->AddText(record.m_Text);
+
+		// No copy of the command. Only the record is moved into the history.
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text added!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandRemove.cpp
+////////////////////////////////////
+class CommandRemove : public Command {
+	Application *m_pApp;
+public:
+	CommandRemove(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Remove};
+		size_t count;
+		std::cout << "Starting index? ";
+		std::cin >> record.m_Index;
+		std::cout << "How many characters to remove? ";
+		std::cin >> count;
+		record.m_Text = m_pApp->GetText().substr(record.m_Index, count);
+		m_pApp->RemoveText(record.m_Index, count);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text removed!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandOverWrite.cpp
+////////////////////////////////////
+class CommandOverWrite : public Command {
+	Application *m_pApp;
+public:
+	CommandOverWrite(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Overwrite};
+		std::string text;
+		std::cout << "Enter text : ";
+		std::cin.ignore();
+		getline(std::cin, text);
+		std::cout << "Position of overwrite? ";
+		std::cin >> record.m_Index;
+		record.m_Text = m_pApp->GetText().substr(record.m_Index, text.size());
+		m_pApp->OverwriteText(record.m_Index, text);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text overwritten!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandInsert.cpp
+////////////////////////////////////
+class CommandInsert : public Command {
+	Application *m_pApp;
+public:
+	CommandInsert(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Insert};
+		std::cout << "Enter text : ";
+		std::cin.ignore();
+		getline(std::cin, record.m_Text);
+		std::cout << "Position of insertion? ";
+		std::cin >> record.m_Index;
+		m_pApp->InsertText(record.m_Index, record.m_Text);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text inserted!");
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  CommandSetColor.cpp
+////////////////////////////////////
+class CommandSetColor : public Command {
+	Application *m_pApp;
+public:
+	CommandSetColor(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		char choice;
+		Color color{};
+		std::cout << "Choose color (r, g, b, w) : ";
+		std::cin >> choice;
+		switch (choice) {
+			case 'r':
+				color = Color::RED;
+				break;
+			case 'g':
+				color = Color::GREEN;
+				break;
+			case 'b':
+				color = Color::BLUE;
+				break;
+			case 'w':
+				color = Color::WHITE;
+				break;
+			default:
+				color = Color::DEFAULT;
+				break;
+		}
+		EditRecord record{EditRecord::Kind::SetColor};
+		record.m_Color = m_pApp->GetColor();
+		m_pApp->SetColor(color);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text color set!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandSetBold.cpp
+////////////////////////////////////
+class CommandSetBold : public Command {
+	Application *m_pApp;
+public:
+	CommandSetBold(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		std::cout << "Press (b) for bold or any other key for normal text";
+		char ch;
+		std::cin >> ch;
+		EditRecord record{EditRecord::Kind::SetBold};
+		record.m_Bold = m_pApp->IsBold();
+		m_pApp->SetBold(ch == 'b');
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text bold property set!");
+	}
+};
+
+
+
+
+/////////////////////////////////
+/////////////////  CommandUndo.cpp
+/////////////////////////////////
+class CommandUndo : public Command {
+	Application *m_pApp;
+public:
+	CommandUndo(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		if (m_pApp->History().Undo(*m_pApp)) {
+			Message("Performed undo!");
+		}
+		else {
+			Message("Nothing to undo.");
+		}
+	}
+};
+
+
+/////////////////////////////////
+/////////////////  CommandRedo.cpp
+/////////////////////////////////
+class CommandRedo : public Command {
+	Application *m_pApp;
+public:
+	CommandRedo(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		if (m_pApp->History().Redo(*m_pApp)) {
+			Message("Performed redo!");
+		}
+		else {
+			Message("Nothing to redo.");
+		}
+	}
+};
+
+
+
+
+////////////////////////////////////////
+////////////////////  	Menu.h
+////////////////////////////////////////
+#include <functional>
+#include <map>
+#include <memory>
+
+class Menu {
+	using Callback = std::shared_ptr<Command>;
+	using CallbackInfo = std::tuple<std::string, Callback>;
+	using Table = std::map<int, CallbackInfo> ;
+	Table m_OptionsTable;
+
+	// returns an iterator to the next callback after the display callback.
+	Table::iterator DisplayData() {
+		auto iter = m_OptionsTable.begin();
+		if (iter->first == 0) { // if the key is 0
+			std::get<1>(iter->second)->Execute();  // in place of  m_pApp->Display();
+			++iter;						  		   // The first entry in map is the Display callback
+		}
+		return iter;
+	}
+
+	void DisplayMenuOptions(Table::iterator iter) {
+		std::cout << "\n------------------------------------------------\n";
+		for (; iter != m_OptionsTable.end(); ++iter) {
+			std::cout << iter->first << ". " << std::get<0>(iter->second) << "\n";
+		}
+	}
+
+	int GetUserChoice() {
+		size_t choice;
+		std::cout << "Your choice (0 to exit)?\n";
+		std::cin >> choice;
+		if (choice == 0)
+			return false;
+		if (choice >= m_OptionsTable.size()) {
+			Message("Unknown option.");
+		} else {
+			std::get<1>(m_OptionsTable[choice])->Execute();
+		}
+		return true;
+	}
+public:
+	void Init(int choice, const std::string &menuText, Callback callback) {
+		m_OptionsTable[choice] = std::make_tuple(menuText, callback);
+	}
+
+
+	void Run() {
+		while (true) {
+			auto iter = DisplayData();
+			DisplayMenuOptions(iter);
+			if (!GetUserChoice()) {
+				break;
+			}
+		}
+		Message("Application terminated");
+	}
+};
+
+
+
+
+
+int main() {
+	// Keep the last 100 edits, with at most 64 KiB of text.
+	Application app{100, 64 * 1024};
+	Menu menu{};
+
+	std::shared_ptr<CommandDisplay>	   cmdDisplay	 = std::make_shared<CommandDisplay>(&app);
+	std::shared_ptr<CommandAdd>		   cmdAdd		 = std::make_shared<CommandAdd>(&app);
+	std::shared_ptr<CommandInsert>     cmdInsert	 = std::make_shared<CommandInsert>(&app);
+	std::shared_ptr<CommandOverWrite>  cmdOverwrite	 = std::make_shared<CommandOverWrite>(&app);
+	std::shared_ptr<CommandRemove>	   cmdRemove	 = std::make_shared<CommandRemove>(&app);
+	std::shared_ptr<CommandSetColor>   cmdSetColor	 = std::make_shared<CommandSetColor>(&app);
+	std::shared_ptr<CommandSetBold>	   cmdSetBold	 = std::make_shared<CommandSetBold>(&app);
+	std::shared_ptr<CommandUndo>	   cmdUndo		 = std::make_shared<CommandUndo>(&app);
+	std::shared_ptr<CommandRedo>	   cmdRedo		 = std::make_shared<CommandRedo>(&app);
+
+	menu.Init(0, "",			  cmdDisplay);
+	menu.Init(1, "Add",			  cmdAdd);
+	menu.Init(2, "Insert",		  cmdInsert);
+	menu.Init(3, "Overwrite",	  cmdOverwrite);
+	menu.Init(4, "Erase",		  cmdRemove);
+	menu.Init(5, "Change color",  cmdSetColor);
+	menu.Init(6, "Toggle bold",	  cmdSetBold);
+	menu.Init(7, "Undo",	  	  cmdUndo);
+	menu.Init(8, "Redo",	  	  cmdRedo);
+
+	menu.Run();
+
+	return 0;
+}
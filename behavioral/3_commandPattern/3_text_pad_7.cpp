@@ -0,0 +1,704 @@
+/*
+	Piece table behind the text pad.
+
+	In 3_text_pad_6.cpp the Application keeps the whole document in one std::string.
+	 - InsertText() and RemoveText() move all the characters after the edit. O(n).
+	 - AddText() builds a temporary string (text + " ").
+	 - The undo records keep their own copies of the inserted and removed text.
+	That is fine for a few lines but not for a log file of many megabytes.
+
+	Now the document is a PieceTable.
+	 - The text is never moved. There are two buffers : the original text (read-only)
+	   and the added text (append-only). Everything typed by the user is appended to
+	   the added buffer.
+	 - The document is a sequence of pieces. A piece is a range of one of the buffers.
+	 - The pieces are kept in a balanced binary tree (a treap) where every node knows
+	   the length of the text in its subtree. Thus finding a position, inserting
+	   and erasing are O(log n) where n is the number of pieces.
+	 - Since the buffers never change, an EditRecord refers to pieces instead of copying
+	   the text. Undo puts the removed pieces back, redo takes them out again.
+	 - Display() writes the pieces straight to the console, one after the other.
+
+	Note : The added buffer only grows. Undo records (bounded by the UndoHistory) and the
+		   document may still refer to any part of it.
+
+	Run with a file name to edit that file : ./build/3_text_pad_7 big.log
+*/
+
+#include <iostream>
+// This will pause the program and prompt the user for input.
+void Message(const std::string &text) {
+	std::cout << "\n----------- " << text << " -----------\n";
+	system(R"(read -p "Press enter to continue!")");
+	system("clear");
+}
+
+
+
+////////////////////////////////////////
+////////////////////  Command.h
+////////////////////////////////////////
+class Command {
+public:
+	virtual void Execute() = 0;
+	virtual ~Command() = default;
+};
+
+
+
+////////////////////////////////////////
+////////////////////  PieceTable.h
+////////////////////////////////////////
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// A range of one of the buffers of the PieceTable.
+struct Piece {
+	bool m_IsAdded{};		// added buffer or original buffer
+	size_t m_Start{};
+	size_t m_Length{};
+};
+
+class PieceTable {
+	struct Node {
+		Piece m_Piece;
+		size_t m_Length;	// length of the text in this subtree
+		uint32_t m_Priority;
+		std::unique_ptr<Node> m_pLeft;
+		std::unique_ptr<Node> m_pRight;
+	};
+	using NodePtr = std::unique_ptr<Node>;
+
+	const std::string m_Original;
+	std::string m_Added;
+	NodePtr m_pRoot;
+	std::minstd_rand m_Random;
+
+	static size_t Length(const NodePtr &pNode) { return pNode ? pNode->m_Length : 0; }
+
+	static void Update(Node *pNode) {
+		pNode->m_Length = Length(pNode->m_pLeft) + pNode->m_Piece.m_Length + Length(pNode->m_pRight);
+	}
+
+	NodePtr NewNode(const Piece &piece) {
+		return NodePtr{new Node{piece, piece.m_Length, static_cast<uint32_t>(m_Random()), nullptr, nullptr}};
+	}
+
+	// All the nodes of a come before the nodes of b.
+	static NodePtr Merge(NodePtr a, NodePtr b) {
+		if (!a) return b;
+		if (!b) return a;
+		if (a->m_Priority > b->m_Priority) {
+			a->m_pRight = Merge(std::move(a->m_pRight), std::move(b));
+			Update(a.get());
+			return a;
+		}
+		b->m_pLeft = Merge(std::move(a), std::move(b->m_pLeft));
+		Update(b.get());
+		return b;
+	}
+
+	// The first tree gets the first pos characters. A piece is cut in two if needed.
+	std::pair<NodePtr, NodePtr> Split(NodePtr pNode, size_t pos) {
+		if (!pNode) return {};
+		size_t leftLength = Length(pNode->m_pLeft);
+		size_t pieceLength = pNode->m_Piece.m_Length;
+		if (pos <= leftLength) {
+			auto parts = Split(std::move(pNode->m_pLeft), pos);
+			pNode->m_pLeft = std::move(parts.second);
+			Update(pNode.get());
+			return {std::move(parts.first), std::move(pNode)};
+		}
+		if (pos >= leftLength + pieceLength) {
+			auto parts = Split(std::move(pNode->m_pRight), pos - leftLength - pieceLength);
+			pNode->m_pRight = std::move(parts.first);
+			Update(pNode.get());
+			return {std::move(pNode), std::move(parts.second)};
+		}
+		size_t offset = pos - leftLength;
+		Piece tail{pNode->m_Piece.m_IsAdded, pNode->m_Piece.m_Start + offset, pieceLength - offset};
+		pNode->m_Piece.m_Length = offset;
+		auto right = Merge(NewNode(tail), std::move(pNode->m_pRight));
+		Update(pNode.get());
+		return {std::move(pNode), std::move(right)};
+	}
+
+	static void Collect(const NodePtr &pNode, std::vector<Piece> &pieces) {
+		if (!pNode) return;
+		Collect(pNode->m_pLeft, pieces);
+		pieces.push_back(pNode->m_Piece);
+		Collect(pNode->m_pRight, pieces);
+	}
+
+	template <typename Fn>
+	void Visit(const NodePtr &pNode, Fn &fn) const {
+		if (!pNode) return;
+		Visit(pNode->m_pLeft, fn);
+		const auto &buffer = pNode->m_Piece.m_IsAdded ? m_Added : m_Original;
+		fn(buffer.data() + pNode->m_Piece.m_Start, pNode->m_Piece.m_Length);
+		Visit(pNode->m_pRight, fn);
+	}
+public:
+	explicit PieceTable(std::string original = {}) : m_Original{std::move(original)} {
+		if (!m_Original.empty()) {
+			m_pRoot = NewNode({false, 0, m_Original.size()});
+		}
+	}
+
+	size_t Size() const { return Length(m_pRoot); }
+
+	// Copies text to the end of the added buffer. The returned piece is not in the document yet.
+	Piece Append(const std::string &text) {
+		Piece piece{true, m_Added.size(), text.size()};
+		m_Added += text;
+		return piece;
+	}
+
+	// Grows the last appended piece, it is contiguous in the added buffer.
+	void Extend(Piece &piece, const std::string &text) {
+		m_Added += text;
+		piece.m_Length += text.size();
+	}
+
+	void Insert(size_t pos, const std::vector<Piece> &pieces) {
+		NodePtr middle;
+		for (auto &piece : pieces) {
+			if (piece.m_Length) {
+				middle = Merge(std::move(middle), NewNode(piece));
+			}
+		}
+		auto parts = Split(std::move(m_pRoot), std::min(pos, Size()));
+		m_pRoot = Merge(Merge(std::move(parts.first), std::move(middle)), std::move(parts.second));
+	}
+
+	// Returns the pieces that were taken out.
+	std::vector<Piece> Erase(size_t pos, size_t count) {
+		auto parts = Split(std::move(m_pRoot), pos);
+		auto rest = Split(std::move(parts.second), count);
+		std::vector<Piece> removed;
+		Collect(rest.first, removed);
+		m_pRoot = Merge(std::move(parts.first), std::move(rest.second));
+		return removed;
+	}
+
+	// Calls fn(const char*, size_t) for every piece, in document order.
+	template <typename Fn>
+	void ForEach(Fn fn) const {
+		Visit(m_pRoot, fn);
+	}
+};
+
+
+
+////////////////////////////////////////
+////////////////////  EditRecord.h
+////////////////////////////////////////
+#include "Console.h"
+
+class Application;
+
+// The state a command needs to undo / redo one edit.
+// A text edit takes the pieces m_Removed out at m_Index and puts m_Inserted in their place.
+struct EditRecord {
+	enum class Kind : uint8_t { Text, SetColor, SetBold };
+	Kind m_Kind{};
+	bool m_Bold{};
+	Color m_Color{};
+	size_t m_Index{};
+	std::vector<Piece> m_Removed;
+	Piece m_Inserted{};
+
+	// Bytes charged against the history's budget. The text itself is in the PieceTable.
+	size_t TextBytes() const { return m_Removed.size() * sizeof(Piece); }
+
+	void Undo(Application &app);
+	void Redo(Application &app);
+};
+
+
+
+////////////////////////////////////////
+////////////////////  	UndoHistory.h
+////////////////////////////////////////
+#include <vector>
+
+class UndoHistory {
+	std::vector<EditRecord> m_Records;	// ring buffer, allocated once
+	size_t m_Begin{};					// oldest record
+	size_t m_Size{};					// records in the ring
+	size_t m_Cursor{};					// [0, m_Cursor) can be undone, [m_Cursor, m_Size) redone
+	size_t m_Bytes{};
+	size_t m_MaxBytes;
+
+	EditRecord& At(size_t i) { return m_Records[(m_Begin + i) % m_Records.size()]; }
+
+	void Free(EditRecord &record) {
+		m_Bytes -= record.TextBytes();
+		std::vector<Piece>{}.swap(record.m_Removed);
+	}
+public:
+	// maxRecords == 0 : no history, the edits are not recorded.
+	UndoHistory(size_t maxRecords, size_t maxBytes) : m_Records(maxRecords), m_MaxBytes{maxBytes} {}
+
+	void Add(EditRecord &&record) {
+		if (m_Records.empty()) {
+			return;
+		}
+		// A new edit makes the undone records unreachable.
+		while (m_Size > m_Cursor) {
+			Free(At(--m_Size));
+		}
+		if (record.TextBytes() > m_MaxBytes) {
+			std::cout << "[History] Edit is too large to be undone.\n";
+			// Older records cannot be replayed across this edit.
+			while (m_Size > 0) {
+				Free(At(--m_Size));
+			}
+			m_Cursor = 0;
+			return;
+		}
+		// Drop the oldest records until the new one fits.
+		while (m_Size == m_Records.size() || m_Bytes + record.TextBytes() > m_MaxBytes) {
+			Free(At(0));
+			m_Begin = (m_Begin + 1) % m_Records.size();
+			--m_Size;
+		}
+		m_Bytes += record.TextBytes();
+		At(m_Size++) = std::move(record);
+		m_Cursor = m_Size;
+	}
+
+	bool Undo(Application &app) {
+		if (m_Cursor == 0) return false;
+		At(--m_Cursor).Undo(app);
+		return true;
+	}
+
+	bool Redo(Application &app) {
+		if (m_Cursor == m_Size) return false;
+		At(m_Cursor++).Redo(app);
+		return true;
+	}
+
+	size_t Size() const { return m_Size; }
+	size_t Bytes() const { return m_Bytes; }
+};
+
+
+
+////////////////////////////////////////
+////////////////////  Application.h
+////////////////////////////////////////
+class Application {
+	PieceTable m_Text;
+	Color m_Color;
+	bool m_Bold;
+	UndoHistory m_History;
+public:
+	Application(std::string text = {}, size_t maxUndo = 1000, size_t maxUndoBytes = 1 << 20)
+		: m_Text{std::move(text)}, m_Color{Color::DEFAULT}, m_Bold{false}, m_History{maxUndo, maxUndoBytes} {}
+
+	// The functions that change the text return the pieces that were inserted / removed.
+	Piece AddText(const std::string &text) {
+		auto piece = m_Text.Append(text);
+		m_Text.Extend(piece, " ");
+		m_Text.Insert(m_Text.Size(), {piece});
+		return piece;
+	}
+	std::vector<Piece> RemoveText(size_t index, size_t count) { return m_Text.Erase(index, count); }
+	Piece InsertText(size_t index, const std::string &text) {
+		auto piece = m_Text.Append(text);
+		m_Text.Insert(index, {piece});
+		return piece;
+	}
+	void InsertPieces(size_t index, const std::vector<Piece> &pieces) { m_Text.Insert(index, pieces); }
+	void SetColor(Color color) { m_Color = color; }
+	void SetBold(bool bold) { m_Bold = bold; }
+	bool IsBold() const { return m_Bold; }
+	Color GetColor() const { return m_Color; }
+	size_t Size() const { return m_Text.Size(); }
+	UndoHistory& History() { return m_History; }
+
+	void Display() const {
+		Console::BeginStyle(m_Color, m_Bold);
+		m_Text.ForEach([](const char *text, size_t length) { std::cout.write(text, length); });
+		Console::EndStyle();
+		std::cout << '\n';
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  EditRecord.cpp
+////////////////////////////////////
+void EditRecord::Undo(Application &app) {
+	switch (m_Kind) {
+		case Kind::Text:
+			app.RemoveText(m_Index, m_Inserted.m_Length);
+			app.InsertPieces(m_Index, m_Removed);
+			break;
+		case Kind::SetColor: {
+			auto color = app.GetColor();
+			app.SetColor(m_Color);
+			m_Color = color;
+			break;
+		}
+		case Kind::SetBold: {
+			auto bold = app.IsBold();
+			app.SetBold(m_Bold);
+			m_Bold = bold;
+			break;
+		}
+	}
+}
+
+void EditRecord::Redo(Application &app) {
+	switch (m_Kind) {
+		case Kind::Text: {
+			size_t count{};
+			for (auto &piece : m_Removed) {
+				count += piece.m_Length;
+			}
+			app.RemoveText(m_Index, count);
+			app.InsertPieces(m_Index, {m_Inserted});
+			break;
+		}
+		// These swap the old and the new state, same as undo.
+		case Kind::SetColor:
+		case Kind::SetBold:
+			Undo(app);
+			break;
+	}
+}
+
+
+////////////////////////////////////
+//////////////////  CommandDisplay.cpp
+////////////////////////////////////
+class CommandDisplay : public Command {
+	Application *m_pApp;
+public:
+	CommandDisplay(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		m_pApp->Display();
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  CommandAdd.cpp
+////////////////////////////////////
+class CommandAdd : public Command {
+	Application *m_pApp;
+public:
+	CommandAdd(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		std::string text;
+		std::cout << "Enter text to add : ";
+		std::cin.ignore(); // to ignore any remaining characters in the input stream
+						   // required when using getline because getline by default reads till next \n
+		std::getline(std::cin, text);
+
+		EditRecord record{EditRecord::Kind::Text};
+		record.m_Index = m_pApp->Size();
+		record.m_Inserted = m_pApp->AddText(text);
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text added!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandRemove.cpp
+////////////////////////////////////
+class CommandRemove : public Command {
+	Application *m_pApp;
+public:
+	CommandRemove(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Text};
+		size_t count;
+		std::cout << "Starting index? ";
+		std::cin >> record.m_Index;
+		std::cout << "How many characters to remove? ";
+		std::cin >> count;
+		record.m_Index = std::min(record.m_Index, m_pApp->Size());
+		record.m_Removed = m_pApp->RemoveText(record.m_Index, count);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text removed!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandOverWrite.cpp
+////////////////////////////////////
+class CommandOverWrite : public Command {
+	Application *m_pApp;
+public:
+	CommandOverWrite(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Text};
+		std::string text;
+		std::cout << "Enter text : ";
+		std::cin.ignore();
+		getline(std::cin, text);
+		std::cout << "Position of overwrite? ";
+		std::cin >> record.m_Index;
+		record.m_Index = std::min(record.m_Index, m_pApp->Size());
+		// Overwrite is a remove followed by an insert at the same position.
+		record.m_Removed = m_pApp->RemoveText(record.m_Index, text.size());
+		record.m_Inserted = m_pApp->InsertText(record.m_Index, text);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text overwritten!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandInsert.cpp
+////////////////////////////////////
+class CommandInsert : public Command {
+	Application *m_pApp;
+public:
+	CommandInsert(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		EditRecord record{EditRecord::Kind::Text};
+		std::string text;
+		std::cout << "Enter text : ";
+		std::cin.ignore();
+		getline(std::cin, text);
+		std::cout << "Position of insertion? ";
+		std::cin >> record.m_Index;
+		record.m_Index = std::min(record.m_Index, m_pApp->Size());
+		record.m_Inserted = m_pApp->InsertText(record.m_Index, text);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text inserted!");
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  CommandSetColor.cpp
+////////////////////////////////////
+class CommandSetColor : public Command {
+	Application *m_pApp;
+public:
+	CommandSetColor(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		char choice;
+		Color color{};
+		std::cout << "Choose color (r, g, b, w) : ";
+		std::cin >> choice;
+		switch (choice) {
+			case 'r':
+				color = Color::RED;
+				break;
+			case 'g':
+				color = Color::GREEN;
+				break;
+			case 'b':
+				color = Color::BLUE;
+				break;
+			case 'w':
+				color = Color::WHITE;
+				break;
+			default:
+				color = Color::DEFAULT;
+				break;
+		}
+		EditRecord record{EditRecord::Kind::SetColor};
+		record.m_Color = m_pApp->GetColor();
+		m_pApp->SetColor(color);
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text color set!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandSetBold.cpp
+////////////////////////////////////
+class CommandSetBold : public Command {
+	Application *m_pApp;
+public:
+	CommandSetBold(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		std::cout << "Press (b) for bold or any other key for normal text";
+		char ch;
+		std::cin >> ch;
+		EditRecord record{EditRecord::Kind::SetBold};
+		record.m_Bold = m_pApp->IsBold();
+		m_pApp->SetBold(ch == 'b');
+
+		m_pApp->History().Add(std::move(record));
+
+		Message("Text bold property set!");
+	}
+};
+
+
+
+
+/////////////////////////////////
+/////////////////  CommandUndo.cpp
+/////////////////////////////////
+class CommandUndo : public Command {
+	Application *m_pApp;
+public:
+	CommandUndo(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		if (m_pApp->History().Undo(*m_pApp)) {
+			Message("Performed undo!");
+		}
+		else {
+			Message("Nothing to undo.");
+		}
+	}
+};
+
+
+/////////////////////////////////
+/////////////////  CommandRedo.cpp
+/////////////////////////////////
+class CommandRedo : public Command {
+	Application *m_pApp;
+public:
+	CommandRedo(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		if (m_pApp->History().Redo(*m_pApp)) {
+			Message("Performed redo!");
+		}
+		else {
+			Message("Nothing to redo.");
+		}
+	}
+};
+
+
+
+
+////////////////////////////////////////
+////////////////////  	Menu.h
+////////////////////////////////////////
+#include <functional>
+#include <map>
+#include <memory>
+
+class Menu {
+	using Callback = std::shared_ptr<Command>;
+	using CallbackInfo = std::tuple<std::string, Callback>;
+	using Table = std::map<int, CallbackInfo> ;
+	Table m_OptionsTable;
+
+	// returns an iterator to the next callback after the display callback.
+	Table::iterator DisplayData() {
+		auto iter = m_OptionsTable.begin();
+		if (iter->first == 0) { // if the key is 0
+			std::get<1>(iter->second)->Execute();  // in place of  m_pApp->Display();
+			++iter;						  		   // The first entry in map is the Display callback
+		}
+		return iter;
+	}
+
+	void DisplayMenuOptions(Table::iterator iter) {
+		std::cout << "\n------------------------------------------------\n";
+		for (; iter != m_OptionsTable.end(); ++iter) {
+			std::cout << iter->first << ". " << std::get<0>(iter->second) << "\n";
+		}
+	}
+
+	int GetUserChoice() {
+		size_t choice;
+		std::cout << "Your choice (0 to exit)?\n";
+		std::cin >> choice;
+		if (choice == 0)
+			return false;
+		if (choice >= m_OptionsTable.size()) {
+			Message("Unknown option.");
+		} else {
+			std::get<1>(m_OptionsTable[choice])->Execute();
+		}
+		return true;
+	}
+public:
+	void Init(int choice, const std::string &menuText, Callback callback) {
+		m_OptionsTable[choice] = std::make_tuple(menuText, callback);
+	}
+
+
+	void Run() {
+		while (true) {
+			auto iter = DisplayData();
+			DisplayMenuOptions(iter);
+			if (!GetUserChoice()) {
+				break;
+			}
+		}
+		Message("Application terminated");
+	}
+};
+
+
+
+
+
+#include <fstream>
+#include <sstream>
+
+int main(int argc, char *argv[]) {
+	std::string text;
+	if (argc > 1) {
+		std::ifstream file{argv[1]};
+		std::stringstream ss;
+		ss << file.rdbuf();
+		text = ss.str();
+	}
+	// Keep the last 100 edits.
+	Application app{std::move(text), 100, 64 * 1024};
+	Menu menu{};
+
+	std::shared_ptr<CommandDisplay>	   cmdDisplay	 = std::make_shared<CommandDisplay>(&app);
+	std::shared_ptr<CommandAdd>		   cmdAdd		 = std::make_shared<CommandAdd>(&app);
+	std::shared_ptr<CommandInsert>     cmdInsert	 = std::make_shared<CommandInsert>(&app);
+	std::shared_ptr<CommandOverWrite>  cmdOverwrite	 = std::make_shared<CommandOverWrite>(&app);
+	std::shared_ptr<CommandRemove>	   cmdRemove	 = std::make_shared<CommandRemove>(&app);
+	std::shared_ptr<CommandSetColor>   cmdSetColor	 = std::make_shared<CommandSetColor>(&app);
+	std::shared_ptr<CommandSetBold>	   cmdSetBold	 = std::make_shared<CommandSetBold>(&app);
+	std::shared_ptr<CommandUndo>	   cmdUndo		 = std::make_shared<CommandUndo>(&app);
+	std::shared_ptr<CommandRedo>	   cmdRedo		 = std::make_shared<CommandRedo>(&app);
+
+	menu.Init(0, "",			  cmdDisplay);
+	menu.Init(1, "Add",			  cmdAdd);
+	menu.Init(2, "Insert",		  cmdInsert);
+	menu.Init(3, "Overwrite",	  cmdOverwrite);
+	menu.Init(4, "Erase",		  cmdRemove);
+	menu.Init(5, "Change color",  cmdSetColor);
+	menu.Init(6, "Toggle bold",	  cmdSetBold);
+	menu.Init(7, "Undo",	  	  cmdUndo);
+	menu.Init(8, "Redo",	  	  cmdRedo);
+
+	menu.Run();
+
+	return 0;
+}
@@ -0,0 +1,1201 @@
+/*
+	Crash recovery with a command journal.
+
+	The text pad of 3_text_pad_8.cpp loses the document and the undo history on exit.
+	Now every executed command is appended to a Journal (see Journal.h) :
+	 - The journal has one record per command : an edit, a color or bold change, an undo,
+	   a redo, or the beginning / end of a transaction. It has no copy of the document.
+	 - The records are written in groups, with one fsync every 100 ms at most,
+	   not one per command.
+	 - On startup the latest snapshot is loaded and the records after it are replayed through
+	   the same functions the commands use. That rebuilds the document and the undo history,
+	   including the transactions.
+	 - Every 50 commands the Application writes a snapshot of its whole state : both buffers
+	   of the PieceTable, the pieces and the undo records. The journal is emptied then,
+	   so the replay never has more than 50 commands to run.
+
+	The commands now call the Application (Apply(), ChangeColor(), Undo() ...), which
+	journals what it executes. Snapshots are not written inside a transaction.
+
+	./build/3_text_pad_9 --check replays a scripted session and compares the recovered document
+	with the live one. It also checks that a journal whose snapshot is lost is not replayed.
+
+	Run with a file name : ./build/3_text_pad_9 notes.txt
+	The journal is notes.txt.journal (textpad.journal without a file name). Delete the journal
+	and its snapshot to start over.
+*/
+
+#include <iostream>
+// This will pause the program and prompt the user for input.
+void Message(const std::string &text) {
+	std::cout << "\n----------- " << text << " -----------\n";
+	system(R"(read -p "Press enter to continue!")");
+	system("clear");
+}
+
+
+
+////////////////////////////////////////
+////////////////////  Command.h
+////////////////////////////////////////
+class Command {
+public:
+	virtual void Execute() = 0;
+	virtual ~Command() = default;
+};
+
+
+
+////////////////////////////////////////
+////////////////////  PieceTable.h
+////////////////////////////////////////
+#include "Journal.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// A range of one of the buffers of the PieceTable.
+struct Piece {
+	bool m_IsAdded{};		// added buffer or original buffer
+	size_t m_Start{};
+	size_t m_Length{};
+};
+
+void PutPiece(RecordWriter &writer, const Piece &piece) {
+	writer.Put(piece.m_IsAdded).Put<uint64_t>(piece.m_Start).Put<uint64_t>(piece.m_Length);
+}
+
+Piece GetPiece(RecordReader &reader) {
+	Piece piece;
+	piece.m_IsAdded = reader.Get<bool>();
+	piece.m_Start = reader.Get<uint64_t>();
+	piece.m_Length = reader.Get<uint64_t>();
+	return piece;
+}
+
+class PieceTable {
+	struct Node {
+		Piece m_Piece;
+		size_t m_Length;	// length of the text in this subtree
+		uint32_t m_Priority;
+		std::unique_ptr<Node> m_pLeft;
+		std::unique_ptr<Node> m_pRight;
+	};
+	using NodePtr = std::unique_ptr<Node>;
+
+	std::string m_Original;
+	std::string m_Added;
+	NodePtr m_pRoot;
+	std::minstd_rand m_Random;
+
+	static size_t Length(const NodePtr &pNode) { return pNode ? pNode->m_Length : 0; }
+
+	static void Update(Node *pNode) {
+		pNode->m_Length = Length(pNode->m_pLeft) + pNode->m_Piece.m_Length + Length(pNode->m_pRight);
+	}
+
+	NodePtr NewNode(const Piece &piece) {
+		return NodePtr{new Node{piece, piece.m_Length, static_cast<uint32_t>(m_Random()), nullptr, nullptr}};
+	}
+
+	// All the nodes of a come before the nodes of b.
+	static NodePtr Merge(NodePtr a, NodePtr b) {
+		if (!a) return b;
+		if (!b) return a;
+		if (a->m_Priority > b->m_Priority) {
+			a->m_pRight = Merge(std::move(a->m_pRight), std::move(b));
+			Update(a.get());
+			return a;
+		}
+		b->m_pLeft = Merge(std::move(a), std::move(b->m_pLeft));
+		Update(b.get());
+		return b;
+	}
+
+	// The first tree gets the first pos characters. A piece is cut in two if needed.
+	std::pair<NodePtr, NodePtr> Split(NodePtr pNode, size_t pos) {
+		if (!pNode) return {};
+		size_t leftLength = Length(pNode->m_pLeft);
+		size_t pieceLength = pNode->m_Piece.m_Length;
+		if (pos <= leftLength) {
+			auto parts = Split(std::move(pNode->m_pLeft), pos);
+			pNode->m_pLeft = std::move(parts.second);
+			Update(pNode.get());
+			return {std::move(parts.first), std::move(pNode)};
+		}
+		if (pos >= leftLength + pieceLength) {
+			auto parts = Split(std::move(pNode->m_pRight), pos - leftLength - pieceLength);
+			pNode->m_pRight = std::move(parts.first);
+			Update(pNode.get());
+			return {std::move(pNode), std::move(parts.second)};
+		}
+		size_t offset = pos - leftLength;
+		Piece tail{pNode->m_Piece.m_IsAdded, pNode->m_Piece.m_Start + offset, pieceLength - offset};
+		pNode->m_Piece.m_Length = offset;
+		auto right = Merge(NewNode(tail), std::move(pNode->m_pRight));
+		Update(pNode.get());
+		return {std::move(pNode), std::move(right)};
+	}
+
+	// Grows the last piece of the tree if piece follows it in the same buffer.
+	static bool Extend(Node *pNode, const Piece &piece) {
+		bool extended{};
+		if (pNode->m_pRight) {
+			extended = Extend(pNode->m_pRight.get(), piece);
+		}
+		else if (pNode->m_Piece.m_IsAdded == piece.m_IsAdded
+				 && pNode->m_Piece.m_Start + pNode->m_Piece.m_Length == piece.m_Start) {
+			pNode->m_Piece.m_Length += piece.m_Length;
+			extended = true;
+		}
+		if (extended) {
+			Update(pNode);
+		}
+		return extended;
+	}
+
+	static void Collect(const NodePtr &pNode, std::vector<Piece> &pieces) {
+		if (!pNode) return;
+		Collect(pNode->m_pLeft, pieces);
+		pieces.push_back(pNode->m_Piece);
+		Collect(pNode->m_pRight, pieces);
+	}
+
+	template <typename Fn>
+	void Visit(const NodePtr &pNode, Fn &fn) const {
+		if (!pNode) return;
+		Visit(pNode->m_pLeft, fn);
+		const auto &buffer = pNode->m_Piece.m_IsAdded ? m_Added : m_Original;
+		fn(buffer.data() + pNode->m_Piece.m_Start, pNode->m_Piece.m_Length);
+		Visit(pNode->m_pRight, fn);
+	}
+public:
+	explicit PieceTable(std::string original = {}) : m_Original{std::move(original)} {
+		if (!m_Original.empty()) {
+			m_pRoot = NewNode({false, 0, m_Original.size()});
+		}
+	}
+
+	size_t Size() const { return Length(m_pRoot); }
+
+	void Save(RecordWriter &writer) const {
+		std::vector<Piece> pieces;
+		Collect(m_pRoot, pieces);
+		writer.PutString(m_Original).PutString(m_Added).Put<uint64_t>(pieces.size());
+		for (auto &piece : pieces) {
+			PutPiece(writer, piece);
+		}
+	}
+
+	void Load(RecordReader &reader) {
+		m_Original = reader.GetString();
+		m_Added = reader.GetString();
+		m_pRoot.reset();
+		for (auto count = reader.Get<uint64_t>(); count > 0 && reader.Ok(); --count) {
+			m_pRoot = Merge(std::move(m_pRoot), NewNode(GetPiece(reader)));
+		}
+	}
+
+	// Copies text to the end of the added buffer. The returned piece is not in the document yet.
+	Piece Append(const std::string &text) {
+		Piece piece{true, m_Added.size(), text.size()};
+		m_Added += text;
+		return piece;
+	}
+
+	// Grows the last appended piece, it is contiguous in the added buffer.
+	void Extend(Piece &piece, const std::string &text) {
+		m_Added += text;
+		piece.m_Length += text.size();
+	}
+
+	void Reserve(size_t length) { m_Added.reserve(m_Added.size() + length); }
+
+	void Insert(size_t pos, const std::vector<Piece> &pieces) {
+		auto parts = Split(std::move(m_pRoot), std::min(pos, Size()));
+		NodePtr middle;
+		for (auto &piece : pieces) {
+			if (!piece.m_Length) {
+				continue;
+			}
+			// Text typed right after the previous edit does not need a new piece.
+			if (!middle && parts.first && Extend(parts.first.get(), piece)) {
+				continue;
+			}
+			middle = Merge(std::move(middle), NewNode(piece));
+		}
+		m_pRoot = Merge(Merge(std::move(parts.first), std::move(middle)), std::move(parts.second));
+	}
+
+	// Returns the pieces that were taken out.
+	std::vector<Piece> Erase(size_t pos, size_t count) {
+		auto parts = Split(std::move(m_pRoot), pos);
+		auto rest = Split(std::move(parts.second), count);
+		std::vector<Piece> removed;
+		Collect(rest.first, removed);
+		m_pRoot = Merge(std::move(parts.first), std::move(rest.second));
+		return removed;
+	}
+
+	// Calls fn(const char*, size_t) for every piece, in document order.
+	template <typename Fn>
+	void ForEach(Fn fn) const {
+		Visit(m_pRoot, fn);
+	}
+};
+
+
+
+////////////////////////////////////////
+////////////////////  EditRecord.h
+////////////////////////////////////////
+#include "Console.h"
+
+class Application;
+
+// The state a command needs to undo / redo one edit.
+// A text edit takes the pieces m_Removed out at m_Index and puts m_Inserted in their place.
+struct EditRecord {
+	enum class Kind : uint8_t { Text, SetColor, SetBold };
+	Kind m_Kind{};
+	bool m_Bold{};
+	Color m_Color{};
+	size_t m_Index{};
+	std::vector<Piece> m_Removed;
+	Piece m_Inserted{};
+	bool m_JoinPrevious{};	// undone / redone together with the record before it (transaction)
+
+	// Merges a text edit that continues this one. False if it does not.
+	bool Coalesce(const EditRecord &next) {
+		if (m_Kind != Kind::Text || next.m_Kind != Kind::Text || !next.m_Removed.empty()
+			|| !m_Inserted.m_IsAdded || !next.m_Inserted.m_IsAdded
+			|| m_Inserted.m_Start + m_Inserted.m_Length != next.m_Inserted.m_Start
+			|| m_Index + m_Inserted.m_Length != next.m_Index) {
+			return false;
+		}
+		m_Inserted.m_Length += next.m_Inserted.m_Length;
+		return true;
+	}
+
+	// Bytes charged against the history's budget. The text itself is in the PieceTable.
+	size_t TextBytes() const { return m_Removed.size() * sizeof(Piece); }
+
+	void Undo(Application &app);
+	void Redo(Application &app);
+
+	void Save(RecordWriter &writer) const {
+		writer.Put(m_Kind).Put(m_Bold).Put(m_Color).Put<uint64_t>(m_Index).Put(m_JoinPrevious);
+		PutPiece(writer, m_Inserted);
+		writer.Put<uint64_t>(m_Removed.size());
+		for (auto &piece : m_Removed) {
+			PutPiece(writer, piece);
+		}
+	}
+
+	void Load(RecordReader &reader) {
+		m_Kind = reader.Get<Kind>();
+		m_Bold = reader.Get<bool>();
+		m_Color = reader.Get<Color>();
+		m_Index = reader.Get<uint64_t>();
+		m_JoinPrevious = reader.Get<bool>();
+		m_Inserted = GetPiece(reader);
+		m_Removed.clear();
+		for (auto count = reader.Get<uint64_t>(); count > 0 && reader.Ok(); --count) {
+			m_Removed.push_back(GetPiece(reader));
+		}
+	}
+};
+
+
+
+////////////////////////////////////////
+////////////////////  	UndoHistory.h
+////////////////////////////////////////
+#include <vector>
+
+class UndoHistory {
+	std::vector<EditRecord> m_Records;	// ring buffer, allocated once
+	size_t m_Begin{};					// oldest record
+	size_t m_Size{};					// records in the ring
+	size_t m_Cursor{};					// [0, m_Cursor) can be undone, [m_Cursor, m_Size) redone
+	size_t m_Bytes{};
+	size_t m_MaxBytes;
+	size_t m_Depth{};					// nested transactions
+	bool m_InGroup{};					// the open transaction has a record
+	bool m_Sealed{true};				// the last record cannot be coalesced
+
+	EditRecord& At(size_t i) { return m_Records[(m_Begin + i) % m_Records.size()]; }
+
+	void Free(EditRecord &record) {
+		m_Bytes -= record.TextBytes();
+		std::vector<Piece>{}.swap(record.m_Removed);
+	}
+
+	// Drops the oldest record and the rest of its transaction.
+	void DropOldest() {
+		do {
+			Free(At(0));
+			m_Begin = (m_Begin + 1) % m_Records.size();
+			--m_Size;
+		} while (m_Size > 0 && At(0).m_JoinPrevious);
+	}
+public:
+	// maxRecords == 0 : no history, the edits are not recorded.
+	UndoHistory(size_t maxRecords, size_t maxBytes) : m_Records(maxRecords), m_MaxBytes{maxBytes} {}
+
+	void Add(EditRecord &&record) {
+		if (m_Records.empty()) {
+			return;
+		}
+		// A new edit makes the undone records unreachable.
+		while (m_Size > m_Cursor) {
+			Free(At(--m_Size));
+		}
+		if (!m_Sealed && m_Cursor > 0 && At(m_Cursor - 1).Coalesce(record)) {
+			return;
+		}
+		m_Sealed = false;
+		record.m_JoinPrevious = m_InGroup;
+		m_InGroup = m_Depth > 0;
+		if (record.TextBytes() > m_MaxBytes) {
+			std::cout << "[History] Edit is too large to be undone.\n";
+			// Older records cannot be replayed across this edit.
+			while (m_Size > 0) {
+				Free(At(--m_Size));
+			}
+			m_Cursor = 0;
+			return;
+		}
+		// Drop the oldest records until the new one fits.
+		while (m_Size == m_Records.size() || m_Bytes + record.TextBytes() > m_MaxBytes) {
+			DropOldest();
+		}
+		// The beginning of the transaction was dropped.
+		if (m_Size == 0) {
+			record.m_JoinPrevious = false;
+		}
+		m_Bytes += record.TextBytes();
+		At(m_Size++) = std::move(record);
+		m_Cursor = m_Size;
+	}
+
+	bool Undo(Application &app) {
+		if (m_Cursor == 0 || m_Depth > 0) return false;
+		bool joined;
+		do {
+			auto &record = At(--m_Cursor);
+			record.Undo(app);
+			joined = record.m_JoinPrevious;
+		} while (joined && m_Cursor > 0);
+		m_Sealed = true;
+		return true;
+	}
+
+	bool Redo(Application &app) {
+		if (m_Cursor == m_Size || m_Depth > 0) return false;
+		do {
+			At(m_Cursor++).Redo(app);
+		} while (m_Cursor < m_Size && At(m_Cursor).m_JoinPrevious);
+		m_Sealed = true;
+		return true;
+	}
+
+	// Use a Transaction instead of calling these.
+	void BeginTransaction() {
+		if (m_Depth++ == 0) {
+			m_Sealed = true;
+			m_InGroup = false;
+		}
+	}
+
+	void EndTransaction() {
+		if (--m_Depth == 0) {
+			m_Sealed = true;
+			m_InGroup = false;
+		}
+	}
+
+	// The next edit starts a new record.
+	void Seal() { m_Sealed = true; }
+
+	bool InTransaction() const { return m_Depth > 0; }
+
+	// m_Sealed is saved too : a snapshot can be taken while the last record is still open,
+	// and the replay must coalesce the next edit into it as the live session did.
+	void Save(RecordWriter &writer) {
+		writer.Put<uint64_t>(m_Size).Put<uint64_t>(m_Cursor).Put(m_Sealed);
+		for (size_t i = 0; i < m_Size; ++i) {
+			At(i).Save(writer);
+		}
+	}
+
+	void Load(RecordReader &reader) {
+		while (m_Size > 0) {
+			Free(At(--m_Size));
+		}
+		m_Begin = 0;
+		auto size = reader.Get<uint64_t>();
+		auto cursor = reader.Get<uint64_t>();
+		auto sealed = reader.Get<bool>();
+		m_Sealed = true;
+		if (size > m_Records.size() || cursor > size) {
+			std::cout << "[History] The saved history does not fit, it is dropped.\n";
+			m_Cursor = 0;
+			return;
+		}
+		for (; m_Size < size && reader.Ok(); ++m_Size) {
+			At(m_Size).Load(reader);
+			m_Bytes += At(m_Size).TextBytes();
+		}
+		m_Cursor = std::min<size_t>(cursor, m_Size);
+		m_Sealed = sealed || !reader.Ok();
+	}
+
+	size_t Size() const { return m_Size; }
+	size_t Bytes() const { return m_Bytes; }
+};
+
+////////////////////////////////////////
+////////////////////  TextEdit.h
+////////////////////////////////////////
+// An edit of the text, as typed by the user.
+// m_Append : m_Text is added at the end (and a space after it).
+// Otherwise m_Count characters at m_Index are replaced by m_Text.
+struct TextEdit {
+	bool m_Append{};
+	size_t m_Index{};
+	size_t m_Count{};
+	std::string m_Text;
+};
+
+
+
+////////////////////////////////////////
+////////////////////  Application.h
+////////////////////////////////////////
+class Application {
+	PieceTable m_Text;
+	Color m_Color;
+	bool m_Bold;
+	UndoHistory m_History;
+	std::vector<TextEdit> *m_pRecording{};
+	Journal *m_pJournal{};		// null while replaying
+
+	enum class Op : uint8_t { Edit, SetColor, SetBold, Undo, Redo, BeginTransaction, EndTransaction };
+
+	void Log(const RecordWriter &record) {
+		if (!m_pJournal) {
+			return;
+		}
+		m_pJournal->Append(record);
+		if (m_pJournal->NeedsSnapshot() && !m_History.InTransaction()) {
+			m_pJournal->WriteSnapshot(Save());
+		}
+	}
+
+	void Replay(RecordReader &reader) {
+		switch (reader.Get<Op>()) {
+			case Op::Edit: {
+				TextEdit edit;
+				edit.m_Append = reader.Get<bool>();
+				edit.m_Index = reader.Get<uint64_t>();
+				edit.m_Count = reader.Get<uint64_t>();
+				edit.m_Text = reader.GetString();
+				Apply(edit);
+				break;
+			}
+			case Op::SetColor:
+				ChangeColor(reader.Get<Color>());
+				break;
+			case Op::SetBold:
+				ChangeBold(reader.Get<bool>());
+				break;
+			case Op::Undo:
+				Undo();
+				break;
+			case Op::Redo:
+				Redo();
+				break;
+			case Op::BeginTransaction:
+				BeginTransaction();
+				break;
+			case Op::EndTransaction:
+				EndTransaction();
+				break;
+		}
+	}
+
+	std::string Save() {
+		RecordWriter writer;
+		writer.Put(m_Color).Put(m_Bold);
+		m_Text.Save(writer);
+		m_History.Save(writer);
+		return writer.Data();
+	}
+
+	void Load(RecordReader &reader) {
+		m_Color = reader.Get<Color>();
+		m_Bold = reader.Get<bool>();
+		m_Text.Load(reader);
+		m_History.Load(reader);
+	}
+public:
+	Application(std::string text = {}, size_t maxUndo = 1000, size_t maxUndoBytes = 1 << 20)
+		: m_Text{std::move(text)}, m_Color{Color::DEFAULT}, m_Bold{false}, m_History{maxUndo, maxUndoBytes} {}
+
+	// The functions that change the text return the pieces that were inserted / removed.
+	Piece AddText(const std::string &text) {
+		auto piece = m_Text.Append(text);
+		m_Text.Extend(piece, " ");
+		m_Text.Insert(m_Text.Size(), {piece});
+		return piece;
+	}
+	std::vector<Piece> RemoveText(size_t index, size_t count) { return m_Text.Erase(index, count); }
+	Piece InsertText(size_t index, const std::string &text) {
+		auto piece = m_Text.Append(text);
+		m_Text.Insert(index, {piece});
+		return piece;
+	}
+	void InsertPieces(size_t index, const std::vector<Piece> &pieces) { m_Text.Insert(index, pieces); }
+	void ReserveText(size_t length) { m_Text.Reserve(length); }
+
+	// Applies the edit and returns the record to undo it. The caller adds it to the history.
+	EditRecord Edit(const TextEdit &edit) {
+		if (m_pRecording) {
+			m_pRecording->push_back(edit);
+		}
+		EditRecord record{EditRecord::Kind::Text};
+		if (edit.m_Append) {
+			record.m_Index = Size();
+			record.m_Inserted = AddText(edit.m_Text);
+			return record;
+		}
+		record.m_Index = std::min(edit.m_Index, Size());
+		if (edit.m_Count) {
+			record.m_Removed = RemoveText(record.m_Index, edit.m_Count);
+		}
+		if (!edit.m_Text.empty()) {
+			record.m_Inserted = InsertText(record.m_Index, edit.m_Text);
+		}
+		return record;
+	}
+
+	// These execute a command and journal it.
+	void Apply(const TextEdit &edit) {
+		m_History.Add(Edit(edit));
+		Log(RecordWriter{}.Put(Op::Edit).Put(edit.m_Append).Put<uint64_t>(edit.m_Index)
+			.Put<uint64_t>(edit.m_Count).PutString(edit.m_Text));
+	}
+
+	void ChangeColor(Color color) {
+		EditRecord record{EditRecord::Kind::SetColor};
+		record.m_Color = m_Color;
+		m_Color = color;
+		m_History.Add(std::move(record));
+		Log(RecordWriter{}.Put(Op::SetColor).Put(color));
+	}
+
+	void ChangeBold(bool bold) {
+		EditRecord record{EditRecord::Kind::SetBold};
+		record.m_Bold = m_Bold;
+		m_Bold = bold;
+		m_History.Add(std::move(record));
+		Log(RecordWriter{}.Put(Op::SetBold).Put(bold));
+	}
+
+	bool Undo() {
+		if (!m_History.Undo(*this)) {
+			return false;
+		}
+		Log(RecordWriter{}.Put(Op::Undo));
+		return true;
+	}
+
+	bool Redo() {
+		if (!m_History.Redo(*this)) {
+			return false;
+		}
+		Log(RecordWriter{}.Put(Op::Redo));
+		return true;
+	}
+
+	void BeginTransaction() {
+		m_History.BeginTransaction();
+		Log(RecordWriter{}.Put(Op::BeginTransaction));
+	}
+
+	void EndTransaction() {
+		m_History.EndTransaction();
+		Log(RecordWriter{}.Put(Op::EndTransaction));
+	}
+
+	// Loads the snapshot and replays the journal, then journals the new commands.
+	// Returns the number of commands replayed.
+	size_t Recover(Journal &journal) {
+		std::string snapshot;
+		bool loaded = journal.LoadSnapshot(snapshot);
+		if (loaded) {
+			RecordReader reader{snapshot};
+			Load(reader);
+		}
+		size_t replayed = journal.Replay([this](RecordReader &reader) { Replay(reader); });
+		m_pJournal = &journal;
+		// A transaction that was open at the crash is closed.
+		while (m_History.InTransaction()) {
+			EndTransaction();
+		}
+		if (!loaded) {
+			journal.WriteSnapshot(Save());
+		}
+		return replayed;
+	}
+
+	// The edits are added to pEdits until Record(nullptr) is called.
+	void Record(std::vector<TextEdit> *pEdits) { m_pRecording = pEdits; }
+	bool IsRecording() const { return m_pRecording != nullptr; }
+	void SetColor(Color color) { m_Color = color; }
+	void SetBold(bool bold) { m_Bold = bold; }
+	bool IsBold() const { return m_Bold; }
+	Color GetColor() const { return m_Color; }
+	size_t Size() const { return m_Text.Size(); }
+
+	std::string Text() const {
+		std::string text;
+		m_Text.ForEach([&text](const char *part, size_t length) { text.append(part, length); });
+		return text;
+	}
+
+	void Display() const {
+		Console::BeginStyle(m_Color, m_Bold);
+		m_Text.ForEach([](const char *text, size_t length) { std::cout.write(text, length); });
+		Console::EndStyle();
+		std::cout << '\n';
+	}
+};
+
+// The commands executed during the lifetime of a Transaction are one undo step.
+class Transaction {
+	Application &m_App;
+public:
+	explicit Transaction(Application &app) : m_App{app} {
+		m_App.BeginTransaction();
+	}
+	~Transaction() {
+		m_App.EndTransaction();
+	}
+	Transaction(const Transaction&) = delete;
+	Transaction& operator=(const Transaction&) = delete;
+};
+
+
+////////////////////////////////////
+//////////////////  EditRecord.cpp
+////////////////////////////////////
+void EditRecord::Undo(Application &app) {
+	switch (m_Kind) {
+		case Kind::Text:
+			app.RemoveText(m_Index, m_Inserted.m_Length);
+			app.InsertPieces(m_Index, m_Removed);
+			break;
+		case Kind::SetColor: {
+			auto color = app.GetColor();
+			app.SetColor(m_Color);
+			m_Color = color;
+			break;
+		}
+		case Kind::SetBold: {
+			auto bold = app.IsBold();
+			app.SetBold(m_Bold);
+			m_Bold = bold;
+			break;
+		}
+	}
+}
+
+void EditRecord::Redo(Application &app) {
+	switch (m_Kind) {
+		case Kind::Text: {
+			size_t count{};
+			for (auto &piece : m_Removed) {
+				count += piece.m_Length;
+			}
+			app.RemoveText(m_Index, count);
+			app.InsertPieces(m_Index, {m_Inserted});
+			break;
+		}
+		// These swap the old and the new state, same as undo.
+		case Kind::SetColor:
+		case Kind::SetBold:
+			Undo(app);
+			break;
+	}
+}
+
+
+////////////////////////////////////
+//////////////////  CommandDisplay.cpp
+////////////////////////////////////
+class CommandDisplay : public Command {
+	Application *m_pApp;
+public:
+	CommandDisplay(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		m_pApp->Display();
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  CommandAdd.cpp
+////////////////////////////////////
+class CommandAdd : public Command {
+	Application *m_pApp;
+public:
+	CommandAdd(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		TextEdit edit{true};
+		std::cout << "Enter text to add : ";
+		std::cin.ignore(); // to ignore any remaining characters in the input stream
+						   // required when using getline because getline by default reads till next \n
+		std::getline(std::cin, edit.m_Text);
+
+		m_pApp->Apply(edit);
+
+		Message("Text added!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandRemove.cpp
+////////////////////////////////////
+class CommandRemove : public Command {
+	Application *m_pApp;
+public:
+	CommandRemove(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		TextEdit edit{};
+		std::cout << "Starting index? ";
+		std::cin >> edit.m_Index;
+		std::cout << "How many characters to remove? ";
+		std::cin >> edit.m_Count;
+
+		m_pApp->Apply(edit);
+
+		Message("Text removed!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandOverWrite.cpp
+////////////////////////////////////
+class CommandOverWrite : public Command {
+	Application *m_pApp;
+public:
+	CommandOverWrite(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		TextEdit edit{};
+		std::cout << "Enter text : ";
+		std::cin.ignore();
+		getline(std::cin, edit.m_Text);
+		std::cout << "Position of overwrite? ";
+		std::cin >> edit.m_Index;
+		// Overwrite is a remove followed by an insert at the same position.
+		edit.m_Count = edit.m_Text.size();
+
+		m_pApp->Apply(edit);
+
+		Message("Text overwritten!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandInsert.cpp
+////////////////////////////////////
+class CommandInsert : public Command {
+	Application *m_pApp;
+public:
+	CommandInsert(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		TextEdit edit{};
+		std::cout << "Enter text : ";
+		std::cin.ignore();
+		getline(std::cin, edit.m_Text);
+		std::cout << "Position of insertion? ";
+		std::cin >> edit.m_Index;
+
+		m_pApp->Apply(edit);
+
+		Message("Text inserted!");
+	}
+};
+
+
+////////////////////////////////////
+//////////////////  CommandSetColor.cpp
+////////////////////////////////////
+class CommandSetColor : public Command {
+	Application *m_pApp;
+public:
+	CommandSetColor(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		char choice;
+		Color color{};
+		std::cout << "Choose color (r, g, b, w) : ";
+		std::cin >> choice;
+		switch (choice) {
+			case 'r':
+				color = Color::RED;
+				break;
+			case 'g':
+				color = Color::GREEN;
+				break;
+			case 'b':
+				color = Color::BLUE;
+				break;
+			case 'w':
+				color = Color::WHITE;
+				break;
+			default:
+				color = Color::DEFAULT;
+				break;
+		}
+		m_pApp->ChangeColor(color);
+
+		Message("Text color set!");
+	}
+};
+
+////////////////////////////////////
+//////////////////  CommandSetBold.cpp
+////////////////////////////////////
+class CommandSetBold : public Command {
+	Application *m_pApp;
+public:
+	CommandSetBold(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		std::cout << "Press (b) for bold or any other key for normal text";
+		char ch;
+		std::cin >> ch;
+		m_pApp->ChangeBold(ch == 'b');
+
+		Message("Text bold property set!");
+	}
+};
+
+
+
+
+/////////////////////////////////
+/////////////////  CommandUndo.cpp
+/////////////////////////////////
+class CommandUndo : public Command {
+	Application *m_pApp;
+public:
+	CommandUndo(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		if (m_pApp->Undo()) {
+			Message("Performed undo!");
+		}
+		else {
+			Message("Nothing to undo.");
+		}
+	}
+};
+
+
+/////////////////////////////////
+/////////////////  CommandRedo.cpp
+/////////////////////////////////
+class CommandRedo : public Command {
+	Application *m_pApp;
+public:
+	CommandRedo(Application* pApp) : m_pApp{pApp} {}
+
+	void Execute() override {
+		if (m_pApp->Redo()) {
+			Message("Performed redo!");
+		}
+		else {
+			Message("Nothing to redo.");
+		}
+	}
+};
+
+
+
+
+/////////////////////////////////
+/////////////////  CommandMacro.cpp
+/////////////////////////////////
+// Plays the recorded edits as one undo step.
+class CommandMacro : public Command {
+	Application *m_pApp;
+	std::vector<TextEdit> m_Edits;
+public:
+	CommandMacro(Application* pApp) : m_pApp{pApp} {}
+
+	std::vector<TextEdit>& Edits() { return m_Edits; }
+
+	void Execute() override {
+		if (m_pApp->IsRecording()) {
+			Message("Stop recording first.");
+			return;
+		}
+		if (m_Edits.empty()) {
+			Message("Nothing recorded.");
+			return;
+		}
+		size_t length{};
+		for (auto &edit : m_Edits) {
+			length += edit.m_Text.size() + 1;
+		}
+		// The added buffer grows once for all the edits.
+		m_pApp->ReserveText(length);
+
+		Transaction transaction{*m_pApp};
+		for (auto &edit : m_Edits) {
+			m_pApp->Apply(edit);
+		}
+
+		Message("Macro played!");
+	}
+};
+
+
+/////////////////////////////////
+/////////////////  CommandRecord.cpp
+/////////////////////////////////
+// Starts or stops recording the edits into the macro.
+class CommandRecord : public Command {
+	Application *m_pApp;
+	CommandMacro *m_pMacro;
+public:
+	CommandRecord(Application* pApp, CommandMacro *pMacro) : m_pApp{pApp}, m_pMacro{pMacro} {}
+
+	void Execute() override {
+		if (m_pApp->IsRecording()) {
+			m_pApp->Record(nullptr);
+			Message("Recorded " + std::to_string(m_pMacro->Edits().size()) + " edits.");
+		}
+		else {
+			m_pMacro->Edits().clear();
+			m_pApp->Record(&m_pMacro->Edits());
+			Message("Recording...");
+		}
+	}
+};
+
+
+
+
+////////////////////////////////////////
+////////////////////  	Menu.h
+////////////////////////////////////////
+#include <functional>
+#include <map>
+#include <memory>
+
+class Menu {
+	using Callback = std::shared_ptr<Command>;
+	using CallbackInfo = std::tuple<std::string, Callback>;
+	using Table = std::map<int, CallbackInfo> ;
+	Table m_OptionsTable;
+
+	// returns an iterator to the next callback after the display callback.
+	Table::iterator DisplayData() {
+		auto iter = m_OptionsTable.begin();
+		if (iter->first == 0) { // if the key is 0
+			std::get<1>(iter->second)->Execute();  // in place of  m_pApp->Display();
+			++iter;						  		   // The first entry in map is the Display callback
+		}
+		return iter;
+	}
+
+	void DisplayMenuOptions(Table::iterator iter) {
+		std::cout << "\n------------------------------------------------\n";
+		for (; iter != m_OptionsTable.end(); ++iter) {
+			std::cout << iter->first << ". " << std::get<0>(iter->second) << "\n";
+		}
+	}
+
+	int GetUserChoice() {
+		size_t choice;
+		std::cout << "Your choice (0 to exit)?\n";
+		std::cin >> choice;
+		if (choice == 0)
+			return false;
+		if (choice >= m_OptionsTable.size()) {
+			Message("Unknown option.");
+		} else {
+			std::get<1>(m_OptionsTable[choice])->Execute();
+		}
+		return true;
+	}
+public:
+	void Init(int choice, const std::string &menuText, Callback callback) {
+		m_OptionsTable[choice] = std::make_tuple(menuText, callback);
+	}
+
+
+	void Run() {
+		while (true) {
+			auto iter = DisplayData();
+			DisplayMenuOptions(iter);
+			if (!GetUserChoice()) {
+				break;
+			}
+		}
+		Message("Application terminated");
+	}
+};
+
+
+
+
+
+#include <fstream>
+#include <sstream>
+
+// ./build/3_text_pad_9 --check
+// Runs the first 1, 2 ... commands of a session with a journal, recovers the document in a
+// second Application and compares it with the live one.
+// Snapshots are taken every 3 commands, so some of them are taken while the last record
+// is still open and the later edits are coalesced into it.
+bool CheckRecovery() {
+	const std::string path{"textpad-check.journal"};
+	auto removeFiles = [&path]() {
+		std::remove(path.c_str());
+		std::remove((path + ".snapshot").c_str());
+	};
+	removeFiles();
+
+	using Step = std::function<void(Application&)>;
+	auto add = [](const char *text) { return Step{[text](Application &app) { app.Apply(TextEdit{true, 0, 0, text}); }}; };
+	const std::vector<Step> steps{
+		[](Application &app) { app.ChangeBold(true); },
+		add("a"), add("b"), add("c"),
+		[](Application &app) { app.Undo(); },
+		add("d"), add("e"),
+		[](Application &app) { app.Undo(); },
+		[](Application &app) { app.Redo(); },
+		add("f"),
+	};
+
+	bool ok = true;
+	for (size_t count = 1; count <= steps.size(); ++count) {
+		removeFiles();
+		std::string liveText;
+		{
+			Application live{{}, 100, 64 * 1024};
+			Journal journal{path, 3};
+			live.Recover(journal);
+			for (size_t i = 0; i < count; ++i) {
+				steps[i](live);
+			}
+			liveText = live.Text();
+		}
+		Application recovered{{}, 100, 64 * 1024};
+		Journal journal{path, 3};
+		recovered.Recover(journal);
+		if (recovered.Text() != liveText) {
+			std::cout << "After " << count << " commands : live \"" << liveText << "\", recovered \""
+					  << recovered.Text() << "\"\n";
+			ok = false;
+		}
+	}
+
+	// Without its snapshot, the emptied journal must not be replayed on an empty document.
+	removeFiles();
+	{
+		Application live{{}, 100, 64 * 1024};
+		Journal journal{path, 3};
+		live.Recover(journal);
+		for (size_t i = 1; i <= 5; ++i) {
+			steps[i](live);
+		}
+	}
+	std::remove((path + ".snapshot").c_str());
+	auto contents = [&path]() {
+		std::ifstream file{path, std::ios::binary};
+		std::stringstream ss;
+		ss << file.rdbuf();
+		return ss.str();
+	};
+	std::string before = contents();
+	{
+		Application recovered{{}, 100, 64 * 1024};
+		Journal journal{path, 3};
+		recovered.Recover(journal);
+		if (!recovered.Text().empty() || journal.IsOpen() || contents() != before) {
+			std::cout << "Without the snapshot : recovered \"" << recovered.Text() << "\"\n";
+			ok = false;
+		}
+	}
+	removeFiles();
+	std::cout << (ok ? "Recovery check passed\n" : "Recovery check FAILED\n");
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && std::string{argv[1]} == "--check") {
+		return CheckRecovery() ? 0 : 1;
+	}
+	std::string text;
+	std::string name{"textpad"};
+	if (argc > 1) {
+		name = argv[1];
+		std::ifstream file{argv[1]};
+		std::stringstream ss;
+		ss << file.rdbuf();
+		text = ss.str();
+	}
+	// Keep the last 100 edits.
+	Application app{std::move(text), 100, 64 * 1024};
+	// Snapshot every 50 commands.
+	Journal journal{name + ".journal", 50};
+	if (auto replayed = app.Recover(journal)) {
+		Message("Recovered " + std::to_string(replayed) + " commands from " + name + ".journal");
+	}
+	Menu menu{};
+
+	std::shared_ptr<CommandDisplay>	   cmdDisplay	 = std::make_shared<CommandDisplay>(&app);
+	std::shared_ptr<CommandAdd>		   cmdAdd		 = std::make_shared<CommandAdd>(&app);
+	std::shared_ptr<CommandInsert>     cmdInsert	 = std::make_shared<CommandInsert>(&app);
+	std::shared_ptr<CommandOverWrite>  cmdOverwrite	 = std::make_shared<CommandOverWrite>(&app);
+	std::shared_ptr<CommandRemove>	   cmdRemove	 = std::make_shared<CommandRemove>(&app);
+	std::shared_ptr<CommandSetColor>   cmdSetColor	 = std::make_shared<CommandSetColor>(&app);
+	std::shared_ptr<CommandSetBold>	   cmdSetBold	 = std::make_shared<CommandSetBold>(&app);
+	std::shared_ptr<CommandUndo>	   cmdUndo		 = std::make_shared<CommandUndo>(&app);
+	std::shared_ptr<CommandRedo>	   cmdRedo		 = std::make_shared<CommandRedo>(&app);
+	std::shared_ptr<CommandMacro>	   cmdMacro		 = std::make_shared<CommandMacro>(&app);
+	std::shared_ptr<CommandRecord>	   cmdRecord	 = std::make_shared<CommandRecord>(&app, cmdMacro.get());
+
+	menu.Init(0, "",			  cmdDisplay);
+	menu.Init(1, "Add",			  cmdAdd);
+	menu.Init(2, "Insert",		  cmdInsert);
+	menu.Init(3, "Overwrite",	  cmdOverwrite);
+	menu.Init(4, "Erase",		  cmdRemove);
+	menu.Init(5, "Change color",  cmdSetColor);
+	menu.Init(6, "Toggle bold",	  cmdSetBold);
+	menu.Init(7, "Undo",	  	  cmdUndo);
+	menu.Init(8, "Redo",	  	  cmdRedo);
+	menu.Init(9, "Record macro (start / stop)", cmdRecord);
+	menu.Init(10, "Play macro",	  cmdMacro);
+
+	menu.Run();
+
+	return 0;
+}
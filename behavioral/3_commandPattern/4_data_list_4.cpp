@@ -0,0 +1,643 @@
+/*
+	Run the commands on worker threads.
+
+	In 4_data_list_2.cpp Menu::Run() executes every command on the UI thread.
+	CommandSort and CommandAverage walk (and copy) the whole list, so with a large list
+	the menu freezes until they are done.
+
+	Now the Menu submits the commands to a CommandExecutor.
+	 - The executor has a pool of worker threads and a queue of commands.
+	 - Submit() returns a TaskHandle. Its future tells when the command is done and
+	   whether it ran to the end or was cancelled.
+	 - Cancel() on the handle (or CancelAll()) sets a flag. A queued command is then skipped.
+	   A running command checks CommandExecutor::IsCancelled() in its loops and stops early.
+	 - A command says whether it only reads the DataList (IsReadOnly()). The commands leave
+	   the queue in order. Read-only commands run at the same time as each other. A command that
+	   changes the list waits until the running ones are done, and the ones after it wait for it.
+	   It is a readers / writer lock that keeps the order of the queue.
+	 - The commands that need input from the user (CommandRemove) ask for it in Prompt(),
+	   which the Menu calls on the UI thread. The Menu does not submit a command again
+	   while its previous run is still queued.
+	 - The Menu never waits for a command, not even for the Display it submits before showing
+	   the options. Behind a long change the data is shown when the change is done, and
+	   "Cancel all" can be chosen meanwhile.
+	 - The output of the commands is written with Print(), one whole line at a time.
+
+
+   Invoker
+---------------  m_OptionsTable  ---------------		 ---------------------
+|	  Menu    |----------------->|	 Command   |<-------| CommandExecutor   |
+---------------                  ---------------	 	 ---------------------
+		|		  Submit()				/_\					|  queue, workers
+		 ------------------------------- | -----------------
+*/
+
+
+#include <iostream>
+#include <string>
+#include <mutex>
+// This will pause the program and prompt the user for input.
+void Message(const std::string &text) {
+	std::cout << "\n----------- " << text << " -----------\n";
+	system(R"(read -p "Press enter to continue!")");
+	system("clear");
+}
+
+// The commands write from several threads. One line is written at a time.
+void Print(const std::string &text) {
+	static std::mutex mtx;
+	std::lock_guard<std::mutex> lock{mtx};
+	std::cout << text << std::endl;
+}
+
+
+
+///////////////////////////////////////
+////////////////// Datalist.h
+///////////////////////////////////////
+#include <vector>
+// Not synchronised. The CommandExecutor never runs a change at the same time as another command.
+class DataList {
+	std::vector<int> m_Data;
+public:
+	void Add(int data) {
+		m_Data.push_back(data);
+	}
+
+	void Remove(size_t index) {
+		if (index >= m_Data.size()) return;
+
+		m_Data.erase(begin(m_Data) + index);
+	}
+
+	const std::vector<int>& GetData() const {
+		return m_Data;
+	}
+};
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	Command.h
+/////////////////////////////////////////////
+class Command {
+public:
+	virtual void Execute() = 0;
+	// Called on the UI thread before the command is submitted.
+	virtual void Prompt() {}
+	// Commands that only read the DataList can run at the same time.
+	virtual bool IsReadOnly() const { return false; }
+	virtual ~Command() = default;
+};
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	CommandExecutor.h
+/////////////////////////////////////////////
+#include <deque>
+#include <list>
+#include <memory>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+
+class TaskHandle {
+	std::shared_future<bool> m_Result;
+	std::shared_ptr<std::atomic<bool>> m_pCancel;
+public:
+	TaskHandle() = default;
+	TaskHandle(std::shared_future<bool> result, std::shared_ptr<std::atomic<bool>> pCancel)
+		: m_Result{std::move(result)}, m_pCancel{std::move(pCancel)} {}
+
+	bool IsValid() const { return m_Result.valid(); }
+	bool IsDone() const {
+		return m_Result.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+	}
+	void Cancel() { *m_pCancel = true; }
+	// True if the command ran to the end, false if it was cancelled.
+	bool Wait() const { return m_Result.get(); }
+	const std::shared_future<bool>& Result() const { return m_Result; }
+};
+
+class CommandExecutor {
+	struct Task {
+		std::shared_ptr<Command> m_pCommand;
+		std::shared_ptr<std::atomic<bool>> m_pCancel;
+		std::promise<bool> m_Result;
+	};
+
+	std::deque<Task> m_Queue;
+	std::list<std::shared_ptr<std::atomic<bool>>> m_Running;	// cancel flags of the running tasks
+	size_t m_Readers{};
+	bool m_Writing{};
+	bool m_Stop{};
+	std::mutex m_Mutex;
+	std::condition_variable m_Changed;
+	std::vector<std::thread> m_Workers;
+
+	static thread_local const std::atomic<bool> *t_pCancel;
+
+	bool CanStart(const Task &task) const {
+		return task.m_pCommand->IsReadOnly() ? !m_Writing : !m_Writing && m_Readers == 0;
+	}
+
+	void Work() {
+		std::unique_lock<std::mutex> lock{m_Mutex};
+		while (true) {
+			m_Changed.wait(lock, [this]() {
+				return (!m_Queue.empty() && CanStart(m_Queue.front())) || (m_Stop && m_Queue.empty());
+			});
+			if (m_Queue.empty()) {
+				return;
+			}
+			Task task = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			bool readOnly = task.m_pCommand->IsReadOnly();
+			if (readOnly) {
+				++m_Readers;
+			}
+			else {
+				m_Writing = true;
+			}
+			auto running = m_Running.insert(m_Running.end(), task.m_pCancel);
+			// Another reader may start too.
+			m_Changed.notify_all();
+			lock.unlock();
+
+			try {
+				bool completed{};
+				if (!*task.m_pCancel) {
+					t_pCancel = task.m_pCancel.get();
+					task.m_pCommand->Execute();
+					t_pCancel = nullptr;
+					completed = !*task.m_pCancel;
+				}
+				task.m_Result.set_value(completed);
+			}
+			catch (...) {
+				t_pCancel = nullptr;
+				task.m_Result.set_exception(std::current_exception());
+			}
+
+			lock.lock();
+			m_Running.erase(running);
+			if (readOnly) {
+				--m_Readers;
+			}
+			else {
+				m_Writing = false;
+			}
+			m_Changed.notify_all();
+		}
+	}
+public:
+	explicit CommandExecutor(size_t workers = std::max(2u, std::thread::hardware_concurrency())) {
+		for (size_t i = 0; i < workers; ++i) {
+			m_Workers.emplace_back(&CommandExecutor::Work, this);
+		}
+	}
+
+	// The queued commands are cancelled, the running ones are waited for.
+	~CommandExecutor() {
+		CancelAll();
+		{
+			std::lock_guard<std::mutex> lock{m_Mutex};
+			m_Stop = true;
+		}
+		m_Changed.notify_all();
+		for (auto &worker : m_Workers) {
+			worker.join();
+		}
+	}
+
+	CommandExecutor(const CommandExecutor&) = delete;
+	CommandExecutor& operator=(const CommandExecutor&) = delete;
+
+	TaskHandle Submit(std::shared_ptr<Command> pCommand) {
+		Task task{std::move(pCommand), std::make_shared<std::atomic<bool>>(false), {}};
+		TaskHandle handle{task.m_Result.get_future().share(), task.m_pCancel};
+		{
+			std::lock_guard<std::mutex> lock{m_Mutex};
+			m_Queue.push_back(std::move(task));
+		}
+		m_Changed.notify_all();
+		return handle;
+	}
+
+	void CancelAll() {
+		std::lock_guard<std::mutex> lock{m_Mutex};
+		for (auto &task : m_Queue) {
+			*task.m_pCancel = true;
+		}
+		for (auto &pCancel : m_Running) {
+			*pCancel = true;
+		}
+	}
+
+	// Long running commands call this in their loops.
+	static bool IsCancelled() {
+		return t_pCancel && *t_pCancel;
+	}
+};
+
+thread_local const std::atomic<bool> *CommandExecutor::t_pCancel{};
+
+
+/*
+ * Add
+ * Remove
+ * Display
+ * Largest
+ * Smallest
+ * Sort
+ * Sum
+ * Average
+ */
+
+#include <sstream>
+#include <climits>
+#include <cstdint>
+
+// The loops check for cancellation once per block of items.
+constexpr size_t CancelCheckInterval = 64 * 1024;
+
+/////////////////////////////////////////////
+////////////////////////  	CommandAdd.h
+/////////////////////////////////////////////
+#include <random>
+class CommandAdd : public Command {
+	DataList *m_pDataList;
+	size_t m_Count;
+public:
+	CommandAdd(DataList *pList, size_t count = 1) : m_pDataList{pList}, m_Count{count} {}
+
+	void Execute() override {
+		std::default_random_engine engine{std::random_device{}()};
+		std::uniform_int_distribution<> dist{0, 100};
+		for (size_t i = 0; i < m_Count; ++i) {
+			if (i % CancelCheckInterval == 0 && CommandExecutor::IsCancelled()) {
+				Print("Add cancelled after " + std::to_string(i) + " items");
+				return;
+			}
+			m_pDataList->Add(dist(engine));
+		}
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandRemove.h
+/////////////////////////////////////////////
+class CommandRemove : public Command {
+	DataList *m_pDataList;
+	size_t m_Index{};
+public:
+	CommandRemove(DataList *pList) : m_pDataList{pList} {}
+
+	void Prompt() override {
+		std::cout << "Remove at index? ";
+		std::cin >> m_Index;
+	}
+
+	void Execute() override {
+		m_pDataList->Remove(m_Index);
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandDisplay.h
+/////////////////////////////////////////////
+class CommandDisplay : public Command {
+	DataList *m_pDataList;
+	size_t m_MaxItems;
+public:
+	CommandDisplay(DataList *pList, size_t maxItems = 20) : m_pDataList{pList}, m_MaxItems{maxItems} {}
+
+	bool IsReadOnly() const override { return true; }
+
+	void Execute() override {
+		const auto &data = m_pDataList->GetData();
+		std::ostringstream out;
+		for (size_t i = 0; i < data.size() && i < m_MaxItems; ++i) {
+			out << data[i] << ", ";
+		}
+		if (data.size() > m_MaxItems) {
+			out << "... (" << data.size() << " items)";
+		}
+		Print(out.str());
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandLargest.h
+/////////////////////////////////////////////
+class CommandLargest : public Command {
+	DataList *m_pDataList;
+public:
+	CommandLargest(DataList *pList) : m_pDataList{pList} {}
+
+	bool IsReadOnly() const override { return true; }
+
+	void Execute() override {
+		int largest = INT_MIN;
+		const auto &data = m_pDataList->GetData();
+		for (size_t i = 0; i < data.size(); ++i) {
+			if (i % CancelCheckInterval == 0 && CommandExecutor::IsCancelled()) {
+				return;
+			}
+			if (largest < data[i])
+				largest = data[i];
+		}
+
+		Print("largest number is : " + std::to_string(largest));
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSmallest.h
+/////////////////////////////////////////////
+class CommandSmallest : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSmallest(DataList *pList) : m_pDataList{pList} {}
+
+	bool IsReadOnly() const override { return true; }
+
+	void Execute() override {
+		int smallest = INT_MAX;
+		const auto &data = m_pDataList->GetData();
+		for (size_t i = 0; i < data.size(); ++i) {
+			if (i % CancelCheckInterval == 0 && CommandExecutor::IsCancelled()) {
+				return;
+			}
+			if (smallest > data[i])
+				smallest = data[i];
+		}
+
+		Print("smallest number is : " + std::to_string(smallest));
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSort.h
+/////////////////////////////////////////////
+class CommandSort : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSort(DataList *pList) : m_pDataList{pList} {}
+
+	bool IsReadOnly() const override { return true; }
+
+	void Execute() override {
+		auto sortedData = m_pDataList->GetData(); // this will create a copy of the vector by invoking the copy constructor.
+		// std::sort cannot be interrupted, the flag is checked before and after it.
+		if (CommandExecutor::IsCancelled()) {
+			return;
+		}
+		std::sort(begin(sortedData), end(sortedData));
+		if (CommandExecutor::IsCancelled()) {
+			return;
+		}
+		std::ostringstream out;
+		out << "Sorted Data : ";
+		for (size_t i = 0; i < sortedData.size() && i < 20; ++i) {
+			out << sortedData[i] << ", ";
+		}
+		if (sortedData.size() > 20) {
+			out << "... (" << sortedData.size() << " items)";
+		}
+		Print(out.str());
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSum.h
+/////////////////////////////////////////////
+// Returns false if the command was cancelled.
+bool Sum(const std::vector<int> &data, int64_t &sum) {
+	sum = 0;
+	for (size_t i = 0; i < data.size(); ++i) {
+		if (i % CancelCheckInterval == 0 && CommandExecutor::IsCancelled()) {
+			return false;
+		}
+		sum += data[i];
+	}
+	return true;
+}
+
+class CommandSum : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSum(DataList *pList) : m_pDataList{pList} {}
+
+	bool IsReadOnly() const override { return true; }
+
+	void Execute() override {
+		int64_t sum;
+		if (Sum(m_pDataList->GetData(), sum)) {
+			Print("Sum : " + std::to_string(sum));
+		}
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandAverage.h
+/////////////////////////////////////////////
+class CommandAverage : public Command {
+	DataList *m_pDataList;
+public:
+	CommandAverage(DataList *pList) : m_pDataList{pList} {}
+
+	bool IsReadOnly() const override { return true; }
+
+	void Execute() override {
+		if (m_pDataList->GetData().empty())
+			return;
+		int64_t sum;
+		if (Sum(m_pDataList->GetData(), sum)) {
+			Print("Average : " + std::to_string(sum / static_cast<int64_t>(m_pDataList->GetData().size())));
+		}
+	}
+};
+
+
+
+////////////////////////////////////////
+////////////////////  	Menu.h
+////////////////////////////////////////
+#include <functional>
+#include <map>
+#include <tuple>
+
+class Menu {
+	using Callback = std::shared_ptr<Command>;
+	using CallbackInfo = std::tuple<std::string, Callback>;
+	using Table = std::map<int, CallbackInfo> ;
+	Table m_OptionsTable;
+	CommandExecutor &m_Executor;
+	std::map<int, TaskHandle> m_LastRun;
+
+	// returns an iterator to the next callback after the display callback.
+	Table::iterator DisplayData() {
+		auto iter = m_OptionsTable.begin();
+		if (iter->first == 0) { // if the key is 0
+			// Not waited for : it runs after the changes queued before, while the menu takes
+			// the next choice. If the previous refresh is still queued, it will show the data.
+			auto &lastRun = m_LastRun[0];
+			if (!lastRun.IsValid() || lastRun.IsDone()) {
+				lastRun = m_Executor.Submit(std::get<1>(iter->second));
+			}
+			++iter;
+		}
+		return iter;
+	}
+
+	void DisplayMenuOptions(Table::iterator iter) {
+		std::ostringstream out;
+		out << "\n------------------------------------------------\n";
+		for (; iter != m_OptionsTable.end(); ++iter) {
+			out << iter->first << ". " << std::get<0>(iter->second) << "\n";
+		}
+		out << m_OptionsTable.size() << ". Cancel all\n";
+		out << "Your choice (0 to exit)?";
+		Print(out.str());
+	}
+
+	int GetUserChoice() {
+		size_t choice;
+		std::cin >> choice;
+		if (choice == 0)
+			return false;
+		if (choice == m_OptionsTable.size()) {
+			m_Executor.CancelAll();
+			Print("Cancelling...");
+		} else if (choice > m_OptionsTable.size()) {
+			Message("Unknown option.");
+		} else {
+			// A command object is not run twice at the same time.
+			auto &lastRun = m_LastRun[choice];
+			if (lastRun.IsValid() && !lastRun.IsDone()) {
+				Print(std::get<0>(m_OptionsTable[choice]) + " is still queued.");
+				return true;
+			}
+			auto &pCommand = std::get<1>(m_OptionsTable[choice]);
+			pCommand->Prompt();
+			lastRun = m_Executor.Submit(pCommand);
+			Print(std::get<0>(m_OptionsTable[choice]) + " queued.");
+		}
+		return true;
+	}
+public:
+	explicit Menu(CommandExecutor &executor) : m_Executor{executor} {}
+
+	void Init(int choice, const std::string &menuText, Callback callback) {
+		m_OptionsTable[choice] = std::make_tuple(menuText, callback);
+	}
+
+
+	void Run() {
+		while (true) {
+			auto iter = DisplayData();
+			DisplayMenuOptions(iter);
+			if (!GetUserChoice()) {
+				break;
+			}
+		}
+		m_Executor.CancelAll();
+		Message("Application terminated");
+	}
+};
+
+
+
+
+
+/////////////////////////////////////
+////////////////////  Macro.h
+/////////////////////////////////////
+#include <list>
+
+class Macro : public Command {
+	using Cmd = std::shared_ptr<Command>;
+	std::list<Cmd> m_Macro;
+public:
+	void Add(Cmd pCmd) {
+		m_Macro.push_back(pCmd);
+	}
+
+	// Read-only if all the commands are.
+	bool IsReadOnly() const override {
+		return std::all_of(begin(m_Macro), end(m_Macro), [](const Cmd &pCmd) { return pCmd->IsReadOnly(); });
+	}
+
+	void Prompt() override {
+		for (auto item : m_Macro) {
+			item->Prompt();
+		}
+	}
+
+	void Execute() override {
+		for (auto item : m_Macro) {
+			if (CommandExecutor::IsCancelled()) {
+				return;
+			}
+			item->Execute();
+		}
+	}
+};
+
+
+
+
+/*
+ * Add
+ * Remove
+ * Display
+ * Largest
+ * Smallest
+ * Sort
+ * Sum
+ * Average
+ */
+
+int main() {
+	DataList data;
+	CommandExecutor executor;
+	Menu menu{executor};
+
+	auto Display 	=   std::make_shared<CommandDisplay>(&data);
+	auto Add 		=   std::make_shared<CommandAdd>(&data);
+	auto AddMillion	=   std::make_shared<CommandAdd>(&data, 1000000);
+	auto Remove 	=   std::make_shared<CommandRemove>(&data);
+	auto Largest 	=   std::make_shared<CommandLargest>(&data);
+	auto Smallest 	=   std::make_shared<CommandSmallest>(&data);
+	auto Sort 		=   std::make_shared<CommandSort>(&data);
+	auto Sum 		=   std::make_shared<CommandSum>(&data);
+	auto Average 	=   std::make_shared<CommandAverage>(&data);
+
+
+	auto macro  	=   std::make_shared<Macro>();
+
+	macro->Add(Average);
+	macro->Add(Sum);
+	macro->Add(Largest);
+	macro->Add(Smallest);
+
+
+	menu.Init(0, "Display",	 	 Display );
+	menu.Init(1, "Add",		 	 Add );
+	menu.Init(2, "Remove",	 	 Remove );
+	menu.Init(3, "Largest",	 	 Largest );
+	menu.Init(4, "Smallest", 	 Smallest );
+	menu.Init(5, "Sort",	 	 Sort );
+	menu.Init(6, "Sum",		 	 Sum );
+	menu.Init(7, "Average",	 	 Average );
+	menu.Init(8, "Macro",	 	 macro );
+	menu.Init(9, "Add a million", AddMillion );
+
+	menu.Run();
+
+	return 0;
+}
@@ -0,0 +1,525 @@
+/*
+	Incremental statistics.
+
+	In 4_data_list_2.cpp CommandLargest, CommandSmallest, CommandSum and CommandAverage
+	walk the whole list every time they are run, and CommandSort copies and sorts it.
+
+	Now the DataList keeps its statistics up to date in Add() and Remove() :
+	 - the sum of the items (64 bit, so it does not overflow on large lists),
+	 - an OrderStatistics tree : the items by value, each distinct value once with its
+	   number of occurrences. Every node knows the number of items in its subtree.
+	   It is a treap (a binary search tree balanced by random priorities).
+
+	Add() and Remove() cost O(log n) more. In exchange
+	 - Sum and Average are O(1),
+	 - Largest, Smallest and the k-th smallest item (Median) are O(log n),
+	 - Sort walks the tree in order, O(n), without copying or sorting.
+*/
+
+
+#include <iostream>
+// This will pause the program and prompt the user for input.
+void Message(const std::string &text) {
+	std::cout << "\n----------- " << text << " -----------\n";
+	system(R"(read -p "Press enter to continue!")");
+	system("clear");
+}
+
+
+
+///////////////////////////////////////
+////////////////// OrderStatistics.h
+///////////////////////////////////////
+#include <memory>
+#include <random>
+#include <utility>
+#include <tuple>
+#include <cstddef>
+#include <cstdint>
+
+// A multiset of ints which can find the k-th smallest item in O(log n).
+class OrderStatistics {
+	struct Node {
+		int m_Value;
+		size_t m_Count;			// occurrences of m_Value
+		size_t m_Size;			// items in this subtree
+		uint32_t m_Priority;
+		std::unique_ptr<Node> m_pLeft;
+		std::unique_ptr<Node> m_pRight;
+	};
+	using NodePtr = std::unique_ptr<Node>;
+
+	NodePtr m_pRoot;
+	std::minstd_rand m_Random;
+
+	static size_t Size(const NodePtr &pNode) { return pNode ? pNode->m_Size : 0; }
+
+	static void Update(Node *pNode) {
+		pNode->m_Size = Size(pNode->m_pLeft) + pNode->m_Count + Size(pNode->m_pRight);
+	}
+
+	static NodePtr Merge(NodePtr a, NodePtr b) {
+		if (!a) return b;
+		if (!b) return a;
+		if (a->m_Priority > b->m_Priority) {
+			a->m_pRight = Merge(std::move(a->m_pRight), std::move(b));
+			Update(a.get());
+			return a;
+		}
+		b->m_pLeft = Merge(std::move(a), std::move(b->m_pLeft));
+		Update(b.get());
+		return b;
+	}
+
+	// first : values < value, second : values >= value
+	static std::pair<NodePtr, NodePtr> SplitLess(NodePtr pNode, int value) {
+		if (!pNode) return {};
+		if (pNode->m_Value < value) {
+			auto parts = SplitLess(std::move(pNode->m_pRight), value);
+			pNode->m_pRight = std::move(parts.first);
+			Update(pNode.get());
+			return {std::move(pNode), std::move(parts.second)};
+		}
+		auto parts = SplitLess(std::move(pNode->m_pLeft), value);
+		pNode->m_pLeft = std::move(parts.second);
+		Update(pNode.get());
+		return {std::move(parts.first), std::move(pNode)};
+	}
+
+	// Splits out the node of value. Returns {values < value, node of value or null, values > value}.
+	std::tuple<NodePtr, NodePtr, NodePtr> Extract(int value) {
+		auto less = SplitLess(std::move(m_pRoot), value);
+		// The node of value is the smallest of the second part, if it is there.
+		NodePtr *ppNode = &less.second;
+		while (*ppNode && (*ppNode)->m_pLeft) {
+			ppNode = &(*ppNode)->m_pLeft;
+		}
+		if (!*ppNode || (*ppNode)->m_Value != value) {
+			return std::make_tuple(std::move(less.first), nullptr, std::move(less.second));
+		}
+		// Only the path to the node changes size. Detach it and fix the sizes on the way back.
+		NodePtr pNode = std::move(*ppNode);
+		*ppNode = std::move(pNode->m_pRight);
+		FixSizes(less.second.get());
+		Update(pNode.get());
+		return std::make_tuple(std::move(less.first), std::move(pNode), std::move(less.second));
+	}
+
+	// Recomputes the sizes along the left spine.
+	static void FixSizes(Node *pNode) {
+		if (!pNode) return;
+		FixSizes(pNode->m_pLeft.get());
+		Update(pNode);
+	}
+
+	template <typename Fn>
+	static void Visit(const NodePtr &pNode, Fn &fn) {
+		if (!pNode) return;
+		Visit(pNode->m_pLeft, fn);
+		fn(pNode->m_Value, pNode->m_Count);
+		Visit(pNode->m_pRight, fn);
+	}
+public:
+	void Insert(int value) {
+		NodePtr less, node, greater;
+		std::tie(less, node, greater) = Extract(value);
+		if (node) {
+			++node->m_Count;
+			Update(node.get());
+		}
+		else {
+			node.reset(new Node{value, 1, 1, static_cast<uint32_t>(m_Random()), nullptr, nullptr});
+		}
+		m_pRoot = Merge(Merge(std::move(less), std::move(node)), std::move(greater));
+	}
+
+	void Erase(int value) {
+		NodePtr less, node, greater;
+		std::tie(less, node, greater) = Extract(value);
+		if (node && --node->m_Count > 0) {
+			Update(node.get());
+		}
+		else {
+			node.reset();
+		}
+		m_pRoot = Merge(Merge(std::move(less), std::move(node)), std::move(greater));
+	}
+
+	size_t Size() const { return Size(m_pRoot); }
+
+	// k in [0, Size())
+	int Kth(size_t k) const {
+		const Node *pNode = m_pRoot.get();
+		while (true) {
+			size_t left = Size(pNode->m_pLeft);
+			if (k < left) {
+				pNode = pNode->m_pLeft.get();
+			}
+			else if (k < left + pNode->m_Count) {
+				return pNode->m_Value;
+			}
+			else {
+				k -= left + pNode->m_Count;
+				pNode = pNode->m_pRight.get();
+			}
+		}
+	}
+
+	int Min() const { return Kth(0); }
+	int Max() const { return Kth(Size() - 1); }
+
+	// Calls fn(value, count) in increasing order of value.
+	template <typename Fn>
+	void ForEach(Fn fn) const {
+		Visit(m_pRoot, fn);
+	}
+};
+
+
+
+///////////////////////////////////////
+////////////////// Datalist.h
+///////////////////////////////////////
+#include <vector>
+class DataList {
+	std::vector<int> m_Data;
+	int64_t m_Sum{};
+	OrderStatistics m_Ordered;
+public:
+	void Add(int data) {
+		m_Data.push_back(data);
+		m_Sum += data;
+		m_Ordered.Insert(data);
+	}
+
+	void Remove(size_t index) {
+		if (index >= m_Data.size()) return;
+
+		m_Sum -= m_Data[index];
+		m_Ordered.Erase(m_Data[index]);
+		m_Data.erase(begin(m_Data) + index);
+	}
+
+	bool IsEmpty() const { return m_Data.empty(); }
+	size_t Size() const { return m_Data.size(); }
+	int64_t Sum() const { return m_Sum; }
+	const OrderStatistics& Ordered() const { return m_Ordered; }
+	
+	const std::vector<int>& GetData() const {
+		return m_Data;
+	}
+};
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	Command.h
+/////////////////////////////////////////////
+class Command {
+public:
+	virtual void Execute() = 0;
+	virtual ~Command() = default;
+};
+
+/*
+ * Add
+ * Remove
+ * Display
+ * Largest
+ * Smallest
+ * Sort
+ * Sum
+ * Average
+ */
+
+#include <iostream>
+
+/////////////////////////////////////////////
+////////////////////////  	CommandAdd.h
+/////////////////////////////////////////////
+#include <random>
+class CommandAdd : public Command {
+	DataList *m_pDataList;
+public:
+	CommandAdd(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		std::default_random_engine engine{std::random_device{}()};
+		std::uniform_int_distribution<> dist{0, 100};
+		m_pDataList->Add(dist(engine));
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandRemove.h
+/////////////////////////////////////////////
+class CommandRemove : public Command {
+	DataList *m_pDataList;
+public:
+	CommandRemove(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		size_t index;
+		std::cout << "Remove at index? ";
+		std::cin >> index;
+		m_pDataList->Remove(index);
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandDisplay.h
+/////////////////////////////////////////////
+class CommandDisplay : public Command {
+	DataList *m_pDataList;
+public:
+	CommandDisplay(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		for (auto item : m_pDataList->GetData()) {
+			std::cout << item << ", ";
+		}
+
+		std::cout << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandLargest.h
+/////////////////////////////////////////////
+class CommandLargest : public Command {
+	DataList *m_pDataList;
+public:
+	CommandLargest(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		if (m_pDataList->IsEmpty())
+			return;
+
+		std::cout << "largest number is : " << m_pDataList->Ordered().Max() << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSmallest.h
+/////////////////////////////////////////////
+class CommandSmallest : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSmallest(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		if (m_pDataList->IsEmpty())
+			return;
+
+		std::cout << "smallest number is : " << m_pDataList->Ordered().Min() << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandMedian.h
+/////////////////////////////////////////////
+class CommandMedian : public Command {
+	DataList *m_pDataList;
+public:
+	CommandMedian(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		if (m_pDataList->IsEmpty())
+			return;
+
+		std::cout << "median is : " << m_pDataList->Ordered().Kth(m_pDataList->Size() / 2) << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSort.h
+/////////////////////////////////////////////
+class CommandSort : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSort(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		std::cout << "Sorted Data : ";
+		// The tree is already in order, no copy to sort.
+		m_pDataList->Ordered().ForEach([](int value, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				std::cout << value << ", ";
+			}
+		});
+		std::cout << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSum.h
+/////////////////////////////////////////////
+class CommandSum : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSum(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		std::cout << "Sum : " << m_pDataList->Sum() << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandAverage.h
+/////////////////////////////////////////////
+class CommandAverage : public Command {
+	DataList *m_pDataList;
+public:
+	CommandAverage(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		if (m_pDataList->IsEmpty())
+			return;
+
+		std::cout << "Average : " << m_pDataList->Sum() / static_cast<int64_t>(m_pDataList->Size()) << std::endl;
+	}
+};
+
+
+
+////////////////////////////////////////
+////////////////////  	Menu.h
+////////////////////////////////////////
+#include <functional>
+#include <map>
+#include <memory>
+
+class Menu {
+	using Callback = std::shared_ptr<Command>;
+	using CallbackInfo = std::tuple<std::string, Callback>;
+	using Table = std::map<int, CallbackInfo> ;
+	Table m_OptionsTable;
+	
+	// returns an iterator to the next callback after the display callback.
+	Table::iterator DisplayData() {
+		auto iter = m_OptionsTable.begin();
+		if (iter->first == 0) { // if the key is 0
+			std::get<1>(iter->second)->Execute();  // in place of  m_pApp->Display();
+			++iter;						  		   // The first entry in map is the Display callback
+		}
+		return iter;
+	}
+
+	void DisplayMenuOptions(Table::iterator iter) {
+		std::cout << "\n------------------------------------------------\n";
+		for (; iter != m_OptionsTable.end(); ++iter) {
+			std::cout << iter->first << ". " << std::get<0>(iter->second) << "\n";
+		}
+	}
+
+	int GetUserChoice() {
+		size_t choice;
+		std::cout << "Your choice (0 to exit)?\n";
+		std::cin >> choice;
+		if (choice == 0)
+			return false;
+		if (choice >= m_OptionsTable.size()) {
+			Message("Unknown option.");
+		} else {
+			std::get<1>(m_OptionsTable[choice])->Execute();
+			Message("Operation completed.");
+		}
+		return true;
+	}
+public:
+	void Init(int choice, const std::string &menuText, Callback callback) {
+		m_OptionsTable[choice] = std::make_tuple(menuText, callback);
+	}
+
+
+	void Run() {
+		while (true) {
+			auto iter = DisplayData();
+			DisplayMenuOptions(iter);
+			if (!GetUserChoice()) {
+				break;
+			}
+		}
+		Message("Application terminated");
+	}
+};
+
+
+
+
+
+/////////////////////////////////////
+////////////////////  Macro.h
+/////////////////////////////////////
+#include <list>
+
+class Macro : public Command {
+	using Cmd = std::shared_ptr<Command>;
+	std::list<Cmd> m_Macro;
+public:
+	void Add(Cmd pCmd) {
+		m_Macro.push_back(pCmd);
+	}
+
+	void Execute() override {
+		for (auto item : m_Macro) {
+			item->Execute();
+		}
+	}
+};
+
+
+
+
+/*
+ * Add
+ * Remove
+ * Display
+ * Largest
+ * Smallest
+ * Sort
+ * Sum
+ * Average
+ */
+
+int main() {
+	DataList data;
+	Menu menu;
+
+	auto Display 	=   std::make_shared<CommandDisplay>(&data);
+	auto Add 		=   std::make_shared<CommandAdd>(&data);
+	auto Remove 	=   std::make_shared<CommandRemove>(&data);
+	auto Largest 	=   std::make_shared<CommandLargest>(&data);
+	auto Smallest 	=   std::make_shared<CommandSmallest>(&data);
+	auto Sort 		=   std::make_shared<CommandSort>(&data);
+	auto Sum 		=   std::make_shared<CommandSum>(&data);
+	auto Average 	=   std::make_shared<CommandAverage>(&data);
+	auto Median 	=   std::make_shared<CommandMedian>(&data);
+
+
+	auto macro  	=   std::make_shared<Macro>();
+	
+	macro->Add(Average);
+	macro->Add(Sum);
+	macro->Add(Largest);
+	macro->Add(Smallest);
+
+
+	menu.Init(0, "Display",	 Display );
+	menu.Init(1, "Add",		 Add );
+	menu.Init(2, "Remove",	 Remove );
+	menu.Init(3, "Largest",	 Largest );
+	menu.Init(4, "Smallest", Smallest );
+	menu.Init(5, "Sort",	 Sort );
+	menu.Init(6, "Sum",		 Sum );
+	menu.Init(7, "Average",	 Average );
+	menu.Init(8, "Macro",	 macro );
+	menu.Init(9, "Median",	 Median );
+
+	menu.Run();
+
+	return 0;
+}
+
+
+
@@ -0,0 +1,634 @@
+/*
+	Parallel sort.
+
+	CommandSort of 4_data_list_6.cpp copies the list, sorts the copy with std::sort on one
+	thread and prints the items one at a time with std::cout <<.
+
+	Now :
+	 - RadixSort sorts ints by their bytes, least significant byte first (LSD radix sort).
+	   A pass counts the items per byte value (histogram) and then moves every item to its
+	   place in a second buffer. Four passes, O(n), no comparisons.
+	   The sign bit is flipped so that the negative numbers come first.
+	   A pass is skipped when all the items have the same byte (the upper bytes of small
+	   numbers), so the items 0 - 100 of the demo are sorted in one pass.
+	 - Lists of ParallelThreshold items or more are cut into one part per hardware thread.
+	   Each thread builds the histogram of its part, then moves the items of its part.
+	   The places of the parts do not overlap, so the threads need no lock.
+	 - CommandSort can sort a copy (the list is not changed) or the DataList itself
+	   (in place : "Sort the list"). Both use one temporary buffer.
+	 - The sorted items are formatted into one string, written with a single write.
+
+	Reduce (Sum, MinMax) is the same as in 4_data_list_6.cpp.
+*/
+
+
+#include <iostream>
+// This will pause the program and prompt the user for input.
+void Message(const std::string &text) {
+	std::cout << "\n----------- " << text << " -----------\n";
+	system(R"(read -p "Press enter to continue!")");
+	system("clear");
+}
+
+
+
+///////////////////////////////////////
+////////////////// Datalist.h
+///////////////////////////////////////
+#include <vector>
+class DataList {
+	std::vector<int> m_Data;
+public:
+	void Add(int data) {
+		m_Data.push_back(data);
+	}
+
+	void Remove(size_t index) {
+		if (index >= m_Data.size()) return;
+
+		m_Data.erase(begin(m_Data) + index);
+	}
+	
+	const std::vector<int>& GetData() const {
+		return m_Data;
+	}
+
+	// Sorts the items of the list.
+	void Sort();
+};
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	Reduce.h
+/////////////////////////////////////////////
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_AVX2_KERNELS
+#endif
+
+struct Range {
+	int m_Min{INT_MAX};
+	int m_Max{INT_MIN};
+};
+
+class Reduce {
+	static int64_t SumScalar(const int *pData, size_t count) {
+		int64_t sum{};
+		for (size_t i = 0; i < count; ++i) {
+			sum += pData[i];
+		}
+		return sum;
+	}
+
+	static Range RangeScalar(const int *pData, size_t count) {
+		Range range;
+		for (size_t i = 0; i < count; ++i) {
+			range.m_Min = std::min(range.m_Min, pData[i]);
+			range.m_Max = std::max(range.m_Max, pData[i]);
+		}
+		return range;
+	}
+
+#ifdef HAS_AVX2_KERNELS
+	__attribute__((target("avx2")))
+	static int64_t SumAvx2(const int *pData, size_t count) {
+		__m256i sum0 = _mm256_setzero_si256();
+		__m256i sum1 = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			// 4 ints widened to 4 int64 each.
+			__m256i low = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i)));
+			__m256i high = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i + 4)));
+			sum0 = _mm256_add_epi64(sum0, low);
+			sum1 = _mm256_add_epi64(sum1, high);
+		}
+		alignas(32) int64_t lanes[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(sum0, sum1));
+		return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumScalar(pData + i, count - i);
+	}
+
+	__attribute__((target("avx2")))
+	static Range RangeAvx2(const int *pData, size_t count) {
+		__m256i min = _mm256_set1_epi32(INT_MAX);
+		__m256i max = _mm256_set1_epi32(INT_MIN);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i items = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + i));
+			min = _mm256_min_epi32(min, items);
+			max = _mm256_max_epi32(max, items);
+		}
+		alignas(32) int mins[8];
+		alignas(32) int maxs[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(mins), min);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(maxs), max);
+		Range range = RangeScalar(pData + i, count - i);
+		for (int lane = 0; lane < 8; ++lane) {
+			range.m_Min = std::min(range.m_Min, mins[lane]);
+			range.m_Max = std::max(range.m_Max, maxs[lane]);
+		}
+		return range;
+	}
+
+	static bool HasAvx2() {
+		static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+		return hasAvx2;
+	}
+#endif
+
+	static int64_t SumKernel(const int *pData, size_t count) {
+#ifdef HAS_AVX2_KERNELS
+		if (HasAvx2()) {
+			return SumAvx2(pData, count);
+		}
+#endif
+		return SumScalar(pData, count);
+	}
+
+	static Range RangeKernel(const int *pData, size_t count) {
+#ifdef HAS_AVX2_KERNELS
+		if (HasAvx2()) {
+			return RangeAvx2(pData, count);
+		}
+#endif
+		return RangeScalar(pData, count);
+	}
+
+	// Runs kernel on one part of the data per thread, then combines the results.
+	template <typename ResultT, typename KernelT, typename CombineT>
+	static ResultT Parallel(const std::vector<int> &data, KernelT kernel, CombineT combine) {
+		if (data.size() < ParallelThreshold) {
+			return kernel(data.data(), data.size());
+		}
+		size_t parts = std::max(1u, std::thread::hardware_concurrency());
+		size_t partSize = (data.size() + parts - 1) / parts;
+		std::vector<std::future<ResultT>> results;
+		// The calling thread reduces the first part.
+		for (size_t begin = partSize; begin < data.size(); begin += partSize) {
+			size_t count = std::min(partSize, data.size() - begin);
+			results.push_back(std::async(std::launch::async, kernel, data.data() + begin, count));
+		}
+		ResultT result = kernel(data.data(), std::min(partSize, data.size()));
+		for (auto &part : results) {
+			result = combine(result, part.get());
+		}
+		return result;
+	}
+public:
+	// Smaller lists are reduced on the calling thread.
+	static constexpr size_t ParallelThreshold = 1 << 20;
+
+	static int64_t Sum(const std::vector<int> &data) {
+		return Parallel<int64_t>(data, SumKernel, [](int64_t a, int64_t b) { return a + b; });
+	}
+
+	static Range MinMax(const std::vector<int> &data) {
+		return Parallel<Range>(data, RangeKernel, [](Range a, Range b) {
+			return Range{std::min(a.m_Min, b.m_Min), std::max(a.m_Max, b.m_Max)};
+		});
+	}
+};
+
+constexpr size_t Reduce::ParallelThreshold;
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	RadixSort.h
+/////////////////////////////////////////////
+#include <array>
+
+class RadixSort {
+	static constexpr unsigned DigitBits = 8;
+	static constexpr size_t Buckets = 1 << DigitBits;
+	using Histogram = std::array<size_t, Buckets>;
+
+	// Flips the sign bit, so the keys of negative numbers are the smallest.
+	static uint32_t Digit(int value, unsigned shift) {
+		return ((static_cast<uint32_t>(value) ^ 0x80000000u) >> shift) & (Buckets - 1);
+	}
+
+	// Calls fn(begin, end) for each part of [0, count), on its own thread.
+	template <typename Fn>
+	static void ForEachPart(size_t count, size_t parts, Fn fn) {
+		size_t partSize = (count + parts - 1) / parts;
+		std::vector<std::thread> threads;
+		for (size_t part = 1; part < parts; ++part) {
+			size_t begin = std::min(count, part * partSize);
+			size_t end = std::min(count, begin + partSize);
+			threads.emplace_back(fn, part, begin, end);
+		}
+		fn(0, 0, std::min(count, partSize));
+		for (auto &thread : threads) {
+			thread.join();
+		}
+	}
+
+	// Moves the items from pFrom to pTo, ordered by the digit at shift.
+	// Returns false (and moves nothing) if all the items have the same digit.
+	static bool Pass(const int *pFrom, int *pTo, size_t count, unsigned shift, size_t parts) {
+		std::vector<Histogram> histograms(parts, Histogram{});
+		ForEachPart(count, parts, [&](size_t part, size_t begin, size_t end) {
+			auto &histogram = histograms[part];
+			for (size_t i = begin; i < end; ++i) {
+				++histogram[Digit(pFrom[i], shift)];
+			}
+		});
+		// The pass is skipped if one digit has all the items, summed over the parts.
+		for (size_t digit = 0; digit < Buckets; ++digit) {
+			size_t digitCount{};
+			for (auto &histogram : histograms) {
+				digitCount += histogram[digit];
+			}
+			if (digitCount == count) {
+				return false;
+			}
+		}
+		// Each histogram entry becomes the place of the first item of that part and digit.
+		size_t offset{};
+		for (size_t digit = 0; digit < Buckets; ++digit) {
+			for (auto &histogram : histograms) {
+				size_t itemCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += itemCount;
+			}
+		}
+		ForEachPart(count, parts, [&](size_t part, size_t begin, size_t end) {
+			auto &places = histograms[part];
+			for (size_t i = begin; i < end; ++i) {
+				pTo[places[Digit(pFrom[i], shift)]++] = pFrom[i];
+			}
+		});
+		return true;
+	}
+public:
+	// Smaller lists are sorted on the calling thread.
+	static constexpr size_t ParallelThreshold = 1 << 18;
+
+	static void Sort(std::vector<int> &data) {
+		if (data.size() < 2) {
+			return;
+		}
+		size_t parts = data.size() < ParallelThreshold ? 1 : std::max(1u, std::thread::hardware_concurrency());
+		std::vector<int> buffer(data.size());
+		int *pFrom = data.data();
+		int *pTo = buffer.data();
+		for (unsigned shift = 0; shift < 32; shift += DigitBits) {
+			if (Pass(pFrom, pTo, data.size(), shift, parts)) {
+				std::swap(pFrom, pTo);
+			}
+		}
+		// The sorted items are in the buffer after an odd number of passes.
+		if (pFrom != data.data()) {
+			data.swap(buffer);
+		}
+	}
+};
+
+constexpr size_t RadixSort::ParallelThreshold;
+
+
+
+///////////////////////////////////////
+////////////////// Datalist.cpp
+///////////////////////////////////////
+void DataList::Sort() {
+	RadixSort::Sort(m_Data);
+}
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	Command.h
+/////////////////////////////////////////////
+class Command {
+public:
+	virtual void Execute() = 0;
+	virtual ~Command() = default;
+};
+
+/*
+ * Add
+ * Remove
+ * Display
+ * Largest
+ * Smallest
+ * Sort
+ * Sum
+ * Average
+ */
+
+#include <iostream>
+
+/////////////////////////////////////////////
+////////////////////////  	CommandAdd.h
+/////////////////////////////////////////////
+#include <random>
+class CommandAdd : public Command {
+	DataList *m_pDataList;
+	size_t m_Count;
+public:
+	CommandAdd(DataList *pList, size_t count = 1) : m_pDataList{pList}, m_Count{count} {}
+
+	void Execute() override {
+		std::default_random_engine engine{std::random_device{}()};
+		std::uniform_int_distribution<> dist{0, 100};
+		for (size_t i = 0; i < m_Count; ++i) {
+			m_pDataList->Add(dist(engine));
+		}
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandRemove.h
+/////////////////////////////////////////////
+class CommandRemove : public Command {
+	DataList *m_pDataList;
+public:
+	CommandRemove(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		size_t index;
+		std::cout << "Remove at index? ";
+		std::cin >> index;
+		m_pDataList->Remove(index);
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandDisplay.h
+/////////////////////////////////////////////
+class CommandDisplay : public Command {
+	DataList *m_pDataList;
+public:
+	CommandDisplay(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		const auto &data = m_pDataList->GetData();
+		for (size_t i = 0; i < data.size() && i < 20; ++i) {
+			std::cout << data[i] << ", ";
+		}
+		if (data.size() > 20) {
+			std::cout << "... (" << data.size() << " items)";
+		}
+
+		std::cout << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandLargest.h
+/////////////////////////////////////////////
+class CommandLargest : public Command {
+	DataList *m_pDataList;
+public:
+	CommandLargest(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		std::cout << "largest number is : " << Reduce::MinMax(m_pDataList->GetData()).m_Max << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSmallest.h
+/////////////////////////////////////////////
+class CommandSmallest : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSmallest(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		std::cout << "smallest number is : " << Reduce::MinMax(m_pDataList->GetData()).m_Min << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSort.h
+/////////////////////////////////////////////
+#include <string>
+
+// Appends "item, " for every item and writes it all at once.
+void WriteItems(const char *title, const std::vector<int> &items) {
+	std::string text{title};
+	text.reserve(text.size() + items.size() * 5 + 1);
+	char digits[12];
+	for (int item : items) {
+		// The digits are written backwards from the end of the array.
+		char *pEnd = digits + sizeof(digits);
+		char *p = pEnd;
+		uint32_t magnitude = item < 0 ? 0u - static_cast<uint32_t>(item) : static_cast<uint32_t>(item);
+		do {
+			*--p = static_cast<char>('0' + magnitude % 10);
+			magnitude /= 10;
+		} while (magnitude);
+		if (item < 0) {
+			*--p = '-';
+		}
+		text.append(p, pEnd);
+		text += ", ";
+	}
+	text += '\n';
+	std::cout.write(text.data(), text.size());
+	std::cout.flush();
+}
+
+class CommandSort : public Command {
+	DataList *m_pDataList;
+	bool m_InPlace;
+public:
+	// inPlace : sorts the DataList itself, otherwise a copy is sorted and printed.
+	CommandSort(DataList *pList, bool inPlace = false) : m_pDataList{pList}, m_InPlace{inPlace} {}
+
+	void Execute() override {
+		if (m_InPlace) {
+			m_pDataList->Sort();
+			std::cout << "The list is sorted." << std::endl;
+			return;
+		}
+		auto sortedData = m_pDataList->GetData(); // this will create a copy of the vector by invoking the copy constructor.
+		RadixSort::Sort(sortedData);
+		WriteItems("Sorted Data : ", sortedData);
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandSum.h
+/////////////////////////////////////////////
+class CommandSum : public Command {
+	DataList *m_pDataList;
+public:
+	CommandSum(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		std::cout << "Sum : " << Reduce::Sum(m_pDataList->GetData()) << std::endl;
+	}
+};
+
+/////////////////////////////////////////////
+////////////////////////  	CommandAverage.h
+/////////////////////////////////////////////
+class CommandAverage : public Command {
+	DataList *m_pDataList;
+public:
+	CommandAverage(DataList *pList) : m_pDataList{pList} {}
+
+	void Execute() override {
+		if (m_pDataList->GetData().empty())
+			return;
+		auto sum = Reduce::Sum(m_pDataList->GetData());
+
+		std::cout << "Average : " <<  sum / static_cast<int64_t>(m_pDataList->GetData().size()) << std::endl;
+	}
+};
+
+
+
+////////////////////////////////////////
+////////////////////  	Menu.h
+////////////////////////////////////////
+#include <functional>
+#include <map>
+#include <memory>
+
+class Menu {
+	using Callback = std::shared_ptr<Command>;
+	using CallbackInfo = std::tuple<std::string, Callback>;
+	using Table = std::map<int, CallbackInfo> ;
+	Table m_OptionsTable;
+	
+	// returns an iterator to the next callback after the display callback.
+	Table::iterator DisplayData() {
+		auto iter = m_OptionsTable.begin();
+		if (iter->first == 0) { // if the key is 0
+			std::get<1>(iter->second)->Execute();  // in place of  m_pApp->Display();
+			++iter;						  		   // The first entry in map is the Display callback
+		}
+		return iter;
+	}
+
+	void DisplayMenuOptions(Table::iterator iter) {
+		std::cout << "\n------------------------------------------------\n";
+		for (; iter != m_OptionsTable.end(); ++iter) {
+			std::cout << iter->first << ". " << std::get<0>(iter->second) << "\n";
+		}
+	}
+
+	int GetUserChoice() {
+		size_t choice;
+		std::cout << "Your choice (0 to exit)?\n";
+		std::cin >> choice;
+		if (choice == 0)
+			return false;
+		if (choice >= m_OptionsTable.size()) {
+			Message("Unknown option.");
+		} else {
+			std::get<1>(m_OptionsTable[choice])->Execute();
+			Message("Operation completed.");
+		}
+		return true;
+	}
+public:
+	void Init(int choice, const std::string &menuText, Callback callback) {
+		m_OptionsTable[choice] = std::make_tuple(menuText, callback);
+	}
+
+
+	void Run() {
+		while (true) {
+			auto iter = DisplayData();
+			DisplayMenuOptions(iter);
+			if (!GetUserChoice()) {
+				break;
+			}
+		}
+		Message("Application terminated");
+	}
+};
+
+
+
+
+
+/////////////////////////////////////
+////////////////////  Macro.h
+/////////////////////////////////////
+#include <list>
+
+class Macro : public Command {
+	using Cmd = std::shared_ptr<Command>;
+	std::list<Cmd> m_Macro;
+public:
+	void Add(Cmd pCmd) {
+		m_Macro.push_back(pCmd);
+	}
+
+	void Execute() override {
+		for (auto item : m_Macro) {
+			item->Execute();
+		}
+	}
+};
+
+
+
+
+/*
+ * Add
+ * Remove
+ * Display
+ * Largest
+ * Smallest
+ * Sort
+ * Sum
+ * Average
+ */
+
+int main() {
+	DataList data;
+	Menu menu;
+
+	auto Display 	=   std::make_shared<CommandDisplay>(&data);
+	auto Add 		=   std::make_shared<CommandAdd>(&data);
+	auto Remove 	=   std::make_shared<CommandRemove>(&data);
+	auto Largest 	=   std::make_shared<CommandLargest>(&data);
+	auto Smallest 	=   std::make_shared<CommandSmallest>(&data);
+	auto Sort 		=   std::make_shared<CommandSort>(&data);
+	auto Sum 		=   std::make_shared<CommandSum>(&data);
+	auto Average 	=   std::make_shared<CommandAverage>(&data);
+	auto AddMillion	=   std::make_shared<CommandAdd>(&data, 1000000);
+	auto SortList	=   std::make_shared<CommandSort>(&data, true);
+
+
+	auto macro  	=   std::make_shared<Macro>();
+	
+	macro->Add(Average);
+	macro->Add(Sum);
+	macro->Add(Largest);
+	macro->Add(Smallest);
+
+
+	menu.Init(0, "Display",	 Display );
+	menu.Init(1, "Add",		 Add );
+	menu.Init(2, "Remove",	 Remove );
+	menu.Init(3, "Largest",	 Largest );
+	menu.Init(4, "Smallest", Smallest );
+	menu.Init(5, "Sort",	 Sort );
+	menu.Init(6, "Sum",		 Sum );
+	menu.Init(7, "Average",	 Average );
+	menu.Init(8, "Macro",	 macro );
+	menu.Init(9, "Add a million", AddMillion );
+	menu.Init(10, "Sort the list", SortList );
+
+	menu.Run();
+
+	return 0;
+}
+
+
+
@@ -0,0 +1,420 @@
+/*
+	Commands as values.
+
+	In the examples so far every command is a Command subclass created with make_shared,
+	the Menu keeps shared_ptr<Command> and the Macro a list of them.
+	To record a million commands (a journal, a long macro) that is a million heap allocations,
+	a million reference counts and a pointer to follow for every call.
+
+	CommandBox holds any command by value :
+	 - The command is stored inside the box, in a buffer of Capacity bytes.
+	   A command which does not fit is a compile error, there is no heap fallback.
+	 - Instead of a virtual base class, the box points to a table of functions (a hand-made
+	   vtable) generated for the type of the command : execute, undo, copy, move, destroy.
+	   The command types need no base class, only Execute() and, optionally, Undo().
+	 - Boxes can be copied and moved like ints. A std::vector<CommandBox> keeps the commands
+	   side by side in memory.
+	 - Move-only commands (e.g. holding a unique_ptr) can be boxed and moved too. Their table
+	   has no copy function, and copying their box throws std::logic_error.
+	 - Execute() and Undo() on an empty box (default constructed, or moved from) throw too.
+
+	The demo records and replays a macro of a million commands, first as shared_ptr<Command>,
+	then as CommandBox, and counts the heap allocations of each.
+*/
+
+#include <iostream>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+// Counts every allocation of the program, to show the difference.
+std::atomic<size_t> allocations{};
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	CommandBox.h
+/////////////////////////////////////////////
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
+
+template <size_t Capacity = 32>
+class CommandBox {
+	struct VTable {
+		void (*m_Execute)(void *pCommand);
+		void (*m_Undo)(void *pCommand);
+		void (*m_Copy)(void *pTo, const void *pFrom);
+		void (*m_Move)(void *pTo, void *pFrom);
+		void (*m_Destroy)(void *pCommand);
+	};
+
+	// Undo() is optional.
+	template <typename T>
+	static auto UndoOf(T &command, int) -> decltype(command.Undo(), void()) { command.Undo(); }
+	template <typename T>
+	static void UndoOf(T&, long) {}
+
+	// Copy is null for move-only commands, T(const T&) is not even instantiated.
+	template <typename T>
+	static void CopyAs(void *pTo, const void *pFrom) { new (pTo) T(*static_cast<const T*>(pFrom)); }
+	using CopyFn = void (*)(void *pTo, const void *pFrom);
+	template <typename T>
+	static constexpr CopyFn CopyOf(std::true_type) { return &CopyAs<T>; }
+	template <typename T>
+	static constexpr CopyFn CopyOf(std::false_type) { return nullptr; }
+
+	// One table per command type, shared by all the boxes of that type.
+	template <typename T>
+	struct VTableOf {
+		static void Execute(void *pCommand) { static_cast<T*>(pCommand)->Execute(); }
+		static void Undo(void *pCommand) { UndoOf(*static_cast<T*>(pCommand), 0); }
+		static void Move(void *pTo, void *pFrom) { new (pTo) T(std::move(*static_cast<T*>(pFrom))); }
+		static void Destroy(void *pCommand) { static_cast<T*>(pCommand)->~T(); }
+		static constexpr VTable Table{&Execute, &Undo, CopyOf<T>(std::is_copy_constructible<T>{}), &Move, &Destroy};
+	};
+
+	alignas(std::max_align_t) unsigned char m_Storage[Capacity];
+	const VTable *m_pVTable{};
+
+	void Reset() {
+		if (m_pVTable) {
+			m_pVTable->m_Destroy(m_Storage);
+			m_pVTable = nullptr;
+		}
+	}
+
+	void CheckNotEmpty() const {
+		if (!m_pVTable) {
+			throw std::logic_error{"CommandBox : the box is empty"};
+		}
+	}
+
+	// The box must be empty.
+	void CopyFrom(const CommandBox &other) {
+		if (!other.m_pVTable) {
+			return;
+		}
+		if (!other.m_pVTable->m_Copy) {
+			throw std::logic_error{"CommandBox : the command is move-only, it cannot be copied"};
+		}
+		other.m_pVTable->m_Copy(m_Storage, other.m_Storage);
+		m_pVTable = other.m_pVTable;
+	}
+public:
+	CommandBox() = default;
+
+	template <typename T, typename = typename std::enable_if<!std::is_same<typename std::decay<T>::type, CommandBox>::value>::type>
+	CommandBox(T &&command) {
+		using CommandT = typename std::decay<T>::type;
+		static_assert(sizeof(CommandT) <= Capacity, "The command does not fit in the box, increase Capacity");
+		static_assert(alignof(CommandT) <= alignof(std::max_align_t), "The command is over-aligned");
+		static_assert(std::is_nothrow_move_constructible<CommandT>::value, "The command must have a noexcept move constructor");
+		new (m_Storage) CommandT(std::forward<T>(command));
+		m_pVTable = &VTableOf<CommandT>::Table;
+	}
+
+	CommandBox(const CommandBox &other) {
+		CopyFrom(other);
+	}
+
+	CommandBox(CommandBox &&other) noexcept : m_pVTable{other.m_pVTable} {
+		if (m_pVTable) {
+			m_pVTable->m_Move(m_Storage, other.m_Storage);
+		}
+	}
+
+	CommandBox& operator=(const CommandBox &other) {
+		if (this != &other) {
+			Reset();
+			CopyFrom(other);
+		}
+		return *this;
+	}
+
+	CommandBox& operator=(CommandBox &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			if (other.m_pVTable) {
+				other.m_pVTable->m_Move(m_Storage, other.m_Storage);
+				m_pVTable = other.m_pVTable;
+			}
+		}
+		return *this;
+	}
+
+	~CommandBox() {
+		Reset();
+	}
+
+	explicit operator bool() const { return m_pVTable != nullptr; }
+	bool IsCopyable() const { return m_pVTable && m_pVTable->m_Copy; }
+
+	void Execute() {
+		CheckNotEmpty();
+		m_pVTable->m_Execute(m_Storage);
+	}
+	void Undo() {
+		CheckNotEmpty();
+		m_pVTable->m_Undo(m_Storage);
+	}
+};
+
+template <size_t Capacity>
+template <typename T>
+constexpr typename CommandBox<Capacity>::VTable CommandBox<Capacity>::VTableOf<T>::Table;
+
+
+
+///////////////////////////////////////
+////////////////// Datalist.h
+///////////////////////////////////////
+#include <vector>
+class DataList {
+	std::vector<int> m_Data;
+public:
+	void Reserve(size_t count) {
+		m_Data.reserve(count);
+	}
+
+	void Add(int data) {
+		m_Data.push_back(data);
+	}
+
+	void RemoveLast() {
+		m_Data.pop_back();
+	}
+
+	void Set(size_t index, int data) {
+		m_Data[index] = data;
+	}
+
+	int Get(size_t index) const {
+		return m_Data[index];
+	}
+
+	size_t Size() const {
+		return m_Data.size();
+	}
+};
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	Command.h
+/////////////////////////////////////////////
+// The classic commands, for comparison.
+class Command {
+public:
+	virtual void Execute() = 0;
+	virtual void Undo() = 0;
+	virtual ~Command() = default;
+};
+
+class CommandAdd : public Command {
+	DataList *m_pDataList;
+	int m_Data;
+public:
+	CommandAdd(DataList *pList, int data) : m_pDataList{pList}, m_Data{data} {}
+
+	void Execute() override { m_pDataList->Add(m_Data); }
+	void Undo() override { m_pDataList->RemoveLast(); }
+};
+
+class CommandSet : public Command {
+	DataList *m_pDataList;
+	size_t m_Index;
+	int m_Data;
+	int m_Previous{};
+public:
+	CommandSet(DataList *pList, size_t index, int data) : m_pDataList{pList}, m_Index{index}, m_Data{data} {}
+
+	void Execute() override {
+		m_Previous = m_pDataList->Get(m_Index);
+		m_pDataList->Set(m_Index, m_Data);
+	}
+	void Undo() override { m_pDataList->Set(m_Index, m_Previous); }
+};
+
+
+
+/////////////////////////////////////////////
+////////////////////////  	Commands.h
+/////////////////////////////////////////////
+#include <memory>
+// The same commands for the CommandBox. No base class, no virtual functions.
+struct AddItem {
+	DataList *m_pDataList;
+	int m_Data;
+
+	void Execute() { m_pDataList->Add(m_Data); }
+	void Undo() { m_pDataList->RemoveLast(); }
+};
+
+struct SetItem {
+	DataList *m_pDataList;
+	size_t m_Index;
+	int m_Data;
+	int m_Previous;
+
+	void Execute() {
+		m_Previous = m_pDataList->Get(m_Index);
+		m_pDataList->Set(m_Index, m_Data);
+	}
+	void Undo() { m_pDataList->Set(m_Index, m_Previous); }
+};
+
+// Move-only : owns the items it adds.
+struct AddItems {
+	DataList *m_pDataList;
+	std::unique_ptr<std::vector<int>> m_pItems;
+
+	void Execute() {
+		for (int item : *m_pItems) {
+			m_pDataList->Add(item);
+		}
+	}
+	void Undo() {
+		for (size_t i = 0; i < m_pItems->size(); ++i) {
+			m_pDataList->RemoveLast();
+		}
+	}
+};
+
+// Commands without Undo() are fine too.
+struct Report {
+	const DataList *m_pDataList;
+
+	void Execute() { std::cout << "The list has " << m_pDataList->Size() << " items\n"; }
+};
+
+
+
+/////////////////////////////////////
+////////////////////  Macro.h
+/////////////////////////////////////
+#include <memory>
+
+template <typename CommandT>
+class Macro {
+	std::vector<CommandT> m_Commands;
+
+	// shared_ptr<Command> and CommandBox are called differently.
+	static void Execute(std::shared_ptr<Command> &pCommand) { pCommand->Execute(); }
+	static void Undo(std::shared_ptr<Command> &pCommand) { pCommand->Undo(); }
+	template <typename BoxT>
+	static void Execute(BoxT &command) { command.Execute(); }
+	template <typename BoxT>
+	static void Undo(BoxT &command) { command.Undo(); }
+public:
+	void Reserve(size_t count) { m_Commands.reserve(count); }
+
+	void Add(CommandT command) {
+		m_Commands.push_back(std::move(command));
+	}
+
+	void Execute() {
+		for (auto &command : m_Commands) {
+			Execute(command);
+		}
+	}
+
+	void Undo() {
+		for (auto it = m_Commands.rbegin(); it != m_Commands.rend(); ++it) {
+			Undo(*it);
+		}
+	}
+};
+
+
+
+/////////////////////////////////////
+////////////////////  main.cpp
+/////////////////////////////////////
+#include <chrono>
+
+constexpr size_t CommandCount = 1000000;
+
+template <typename CommandT, typename MakeAddT, typename MakeSetT>
+void Run(const char *name, MakeAddT makeAdd, MakeSetT makeSet) {
+	DataList list;
+	list.Reserve(CommandCount);
+	Macro<CommandT> macro;
+	macro.Reserve(CommandCount);
+
+	auto start = std::chrono::steady_clock::now();
+	size_t before = allocations.load();
+	// Record : every other command changes the item added before it.
+	for (size_t i = 0; i < CommandCount; ++i) {
+		if (i % 2 == 0) {
+			macro.Add(makeAdd(&list, static_cast<int>(i)));
+		}
+		else {
+			macro.Add(makeSet(&list, i / 2, -static_cast<int>(i)));
+		}
+	}
+	size_t recorded = allocations.load() - before;
+
+	// Replay, undo and replay again.
+	before = allocations.load();
+	macro.Execute();
+	macro.Undo();
+	macro.Execute();
+	size_t replayed = allocations.load() - before;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << name << "\n"
+			  << "  allocations to record " << CommandCount << " commands : " << recorded << "\n"
+			  << "  allocations to replay them : " << replayed << "\n"
+			  << "  time : " << ms << " ms (items : " << list.Size() << ")\n";
+}
+
+int main() {
+	Run<std::shared_ptr<Command>>("shared_ptr<Command>",
+		[](DataList *pList, int data) { return std::make_shared<CommandAdd>(pList, data); },
+		[](DataList *pList, size_t index, int data) { return std::make_shared<CommandSet>(pList, index, data); });
+
+	Run<CommandBox<>>("CommandBox",
+		[](DataList *pList, int data) { return AddItem{pList, data}; },
+		[](DataList *pList, size_t index, int data) { return SetItem{pList, index, data, 0}; });
+
+	// Boxes are values : they can be copied, and hold any command type.
+	DataList list;
+	CommandBox<> report{Report{&list}};
+	CommandBox<> copy = report;
+	CommandBox<>{AddItem{&list, 42}}.Execute();
+	copy.Execute();
+	copy.Undo();	// Report has no Undo(), nothing happens
+
+	// A move-only command is boxed and moved, but not copied.
+	std::vector<CommandBox<>> journal;
+	journal.push_back(AddItems{&list, std::unique_ptr<std::vector<int>>{new std::vector<int>{1, 2, 3}}});
+	journal.back().Execute();
+	report.Execute();
+	std::cout << "Copyable : " << journal.back().IsCopyable() << "\n";
+	try {
+		CommandBox<> copied = journal.back();
+	}
+	catch (const std::logic_error &e) {
+		std::cout << e.what() << "\n";
+	}
+
+	return 0;
+}
@@ -37,5 +37,17 @@ public:
 	static void WriteLine(const std::string& text, Color color, bool bold) {
 		Write(text + '\n', color, bold);
 	}
+
+	// For text that is written in several parts. Call EndStyle() after the last part.
+	static void BeginStyle(Color color, bool bold) {
+		std::cout << GetColor(color);
+		if (bold) {
+			std::cout << "\033[1;21m";
+		}
+	}
+
+	static void EndStyle() {
+		std::cout << "\033[1;0m";
+	}
 };
 
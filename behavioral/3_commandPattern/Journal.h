@@ -0,0 +1,350 @@
+#pragma once
+/*
+	Append-only journal of executed commands, for crash recovery.
+
+	File <path> holds the records, one after the other :
+		uint32 size			of the payload
+		uint32 checksum		of the sequence number and the payload
+		uint64 sequence		1, 2, 3 ... never reused
+		char   payload[size]
+	File <path>.snapshot holds the state of the application after some record :
+		uint64 sequence		of the last record included in the snapshot
+		uint32 checksum
+		char   payload[]
+
+	 - Group commit : Append() only copies the record to a buffer. A flusher thread
+	   writes the buffer and calls fsync() every syncInterval, or sooner when the buffer
+	   holds maxPending bytes. So many commands share one write and one fsync.
+	   A crash loses at most the last syncInterval of commands.
+	 - Replay() reads the records back. A torn or corrupt record at the end (crash in the
+	   middle of a write) ends the replay and is cut from the file.
+	   The first record replayed must follow the snapshot. If it does not (the snapshot was
+	   lost or is corrupt, and the journal was emptied when it was written), the records
+	   cannot be applied : Replay() reports the gap, replays nothing and leaves the files
+	   as they are. The journal is closed, the commands of this session are not saved.
+	 - WriteSnapshot() writes the snapshot to a temporary file, syncs it and renames it,
+	   then empties the journal. Records already in the snapshot are skipped by Replay(),
+	   so a crash between the rename and the truncation is harmless.
+	   NeedsSnapshot() tells when snapshotEvery records were appended since the last one,
+	   which bounds the replay time.
+
+	Append(), WriteSnapshot() and Replay() must be called from the same thread.
+*/
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Builds the payload of a record.
+class RecordWriter {
+	std::string m_Data;
+public:
+	template <typename T>
+	RecordWriter& Put(T value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Use PutString()");
+		m_Data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		return *this;
+	}
+
+	RecordWriter& PutString(const std::string &text) {
+		Put<uint64_t>(text.size());
+		m_Data += text;
+		return *this;
+	}
+
+	const std::string& Data() const { return m_Data; }
+};
+
+// Reads the payload of a record. After a read past the end, Ok() is false and reads return {}.
+class RecordReader {
+	const char *m_pData;
+	size_t m_Size;
+	size_t m_Pos{};
+	bool m_Ok{true};
+
+	bool Has(size_t count) {
+		m_Ok = m_Ok && count <= m_Size - m_Pos;
+		return m_Ok;
+	}
+public:
+	RecordReader(const char *pData, size_t size) : m_pData{pData}, m_Size{size} {}
+	explicit RecordReader(const std::string &data) : RecordReader{data.data(), data.size()} {}
+
+	template <typename T>
+	T Get() {
+		T value{};
+		if (Has(sizeof(T))) {
+			std::memcpy(&value, m_pData + m_Pos, sizeof(T));
+			m_Pos += sizeof(T);
+		}
+		return value;
+	}
+
+	std::string GetString() {
+		auto size = Get<uint64_t>();
+		if (!Has(size)) {
+			return {};
+		}
+		std::string text{m_pData + m_Pos, static_cast<size_t>(size)};
+		m_Pos += size;
+		return text;
+	}
+
+	bool Ok() const { return m_Ok; }
+};
+
+class Journal {
+	struct Header {
+		uint32_t m_Size;
+		uint32_t m_Checksum;
+		uint64_t m_Sequence;
+	};
+
+	std::string m_Path;
+	int m_File{-1};
+	uint64_t m_Sequence{};				// of the last record appended or replayed
+	uint64_t m_SnapshotSequence{};
+	size_t m_SnapshotEvery;
+
+	std::chrono::milliseconds m_SyncInterval;
+	size_t m_MaxPending;
+	std::string m_Pending;				// appended, not written yet
+	bool m_Stop{};
+	std::mutex m_Mutex;					// m_Pending, m_Stop
+	std::mutex m_WriteMutex;			// the file
+	std::condition_variable m_Wakeup;
+	std::thread m_Flusher;
+
+	// FNV-1a
+	static uint32_t Checksum(uint64_t sequence, const char *pData, size_t size) {
+		uint32_t hash = 2166136261u;
+		auto add = [&hash](const char *p, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				hash = (hash ^ static_cast<uint8_t>(p[i])) * 16777619u;
+			}
+		};
+		add(reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+		add(pData, size);
+		return hash;
+	}
+
+	static bool WriteAll(int file, const char *pData, size_t size) {
+		while (size > 0) {
+			auto written = ::write(file, pData, size);
+			if (written < 0) {
+				return false;
+			}
+			pData += written;
+			size -= static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+	static bool ReadFile(const std::string &path, std::string &contents) {
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		char buffer[64 * 1024];
+		ssize_t count;
+		while ((count = ::read(file, buffer, sizeof(buffer))) > 0) {
+			contents.append(buffer, static_cast<size_t>(count));
+		}
+		::close(file);
+		return count == 0;
+	}
+
+	void FlushLoop() {
+		std::unique_lock<std::mutex> lock{m_Mutex};
+		while (!m_Stop) {
+			m_Wakeup.wait_for(lock, m_SyncInterval, [this]() { return m_Stop || m_Pending.size() >= m_MaxPending; });
+			lock.unlock();
+			Flush();
+			lock.lock();
+		}
+	}
+public:
+	Journal(std::string path, size_t snapshotEvery = 1000,
+			std::chrono::milliseconds syncInterval = std::chrono::milliseconds{100}, size_t maxPending = 64 * 1024)
+		: m_Path{std::move(path)}, m_SnapshotEvery{snapshotEvery}, m_SyncInterval{syncInterval}, m_MaxPending{maxPending} {
+		m_File = ::open(m_Path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+		if (m_File < 0) {
+			std::cout << "[Journal] Cannot open " << m_Path << ", the commands will not be saved.\n";
+			return;
+		}
+		m_Flusher = std::thread{&Journal::FlushLoop, this};
+	}
+
+	~Journal() {
+		if (m_Flusher.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock{m_Mutex};
+				m_Stop = true;
+			}
+			m_Wakeup.notify_one();
+			m_Flusher.join();
+		}
+		Flush();
+		if (m_File >= 0) {
+			::close(m_File);
+		}
+	}
+
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	bool IsOpen() const { return m_File >= 0; }
+
+	// The file is kept as it is. Nothing is written any more.
+	void Close() {
+		std::lock_guard<std::mutex> writeLock{m_WriteMutex};
+		if (m_File >= 0) {
+			::close(m_File);
+			m_File = -1;
+		}
+		std::lock_guard<std::mutex> lock{m_Mutex};
+		m_Pending.clear();
+	}
+
+	// Returns false if there is no valid snapshot.
+	bool LoadSnapshot(std::string &payload) {
+		std::string contents;
+		if (!ReadFile(m_Path + ".snapshot", contents)) {
+			return false;
+		}
+		RecordReader reader{contents};
+		auto sequence = reader.Get<uint64_t>();
+		auto checksum = reader.Get<uint32_t>();
+		const size_t headerSize = sizeof(uint64_t) + sizeof(uint32_t);
+		if (!reader.Ok() || checksum != Checksum(sequence, contents.data() + headerSize, contents.size() - headerSize)) {
+			std::cout << "[Journal] The snapshot is corrupt, ignoring it.\n";
+			return false;
+		}
+		payload.assign(contents, headerSize, std::string::npos);
+		m_Sequence = m_SnapshotSequence = sequence;
+		return true;
+	}
+
+	// Calls fn(RecordReader&) for every record after the snapshot. Returns the number of records.
+	template <typename Fn>
+	size_t Replay(Fn fn) {
+		std::string contents;
+		if (!IsOpen() || !ReadFile(m_Path, contents)) {
+			return 0;
+		}
+		size_t replayed{};
+		size_t pos{};
+		while (contents.size() - pos >= sizeof(Header)) {
+			Header header;
+			std::memcpy(&header, contents.data() + pos, sizeof(Header));
+			const char *pPayload = contents.data() + pos + sizeof(Header);
+			if (header.m_Size > contents.size() - pos - sizeof(Header)
+				|| header.m_Checksum != Checksum(header.m_Sequence, pPayload, header.m_Size)) {
+				break;
+			}
+			pos += sizeof(Header) + header.m_Size;
+			if (header.m_Sequence <= m_Sequence) {
+				continue;	// already in the snapshot
+			}
+			if (header.m_Sequence != m_Sequence + 1) {
+				std::cout << "[Journal] Record " << header.m_Sequence << " does not follow record " << m_Sequence
+						  << ", the records in between are missing. Not replaying " << m_Path << "\n";
+				Close();
+				return replayed;
+			}
+			m_Sequence = header.m_Sequence;
+			RecordReader reader{pPayload, header.m_Size};
+			fn(reader);
+			++replayed;
+		}
+		if (pos < contents.size()) {
+			std::cout << "[Journal] Dropping " << contents.size() - pos << " bytes of an incomplete record.\n";
+			if (::ftruncate(m_File, static_cast<off_t>(pos)) != 0) {
+				std::cout << "[Journal] Cannot truncate " << m_Path << "\n";
+			}
+		}
+		return replayed;
+	}
+
+	// The record is on disk after the next sync.
+	void Append(const RecordWriter &record) {
+		if (!IsOpen()) {
+			return;
+		}
+		const auto &payload = record.Data();
+		Header header{static_cast<uint32_t>(payload.size()), 0, ++m_Sequence};
+		header.m_Checksum = Checksum(header.m_Sequence, payload.data(), payload.size());
+		bool wake;
+		{
+			std::lock_guard<std::mutex> lock{m_Mutex};
+			m_Pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+			m_Pending += payload;
+			wake = m_Pending.size() >= m_MaxPending;
+		}
+		if (wake) {
+			m_Wakeup.notify_one();
+		}
+	}
+
+	// Writes the pending records with one write and one fsync.
+	void Flush() {
+		std::lock_guard<std::mutex> writeLock{m_WriteMutex};
+		std::string pending;
+		{
+			std::lock_guard<std::mutex> lock{m_Mutex};
+			pending.swap(m_Pending);
+		}
+		if (pending.empty() || !IsOpen()) {
+			return;
+		}
+		if (!WriteAll(m_File, pending.data(), pending.size()) || ::fsync(m_File) != 0) {
+			std::cout << "[Journal] Cannot write " << m_Path << "\n";
+		}
+	}
+
+	bool NeedsSnapshot() const { return m_Sequence - m_SnapshotSequence >= m_SnapshotEvery; }
+
+	// payload is the state after the last appended record.
+	void WriteSnapshot(const std::string &payload) {
+		if (!IsOpen()) {
+			return;
+		}
+		Flush();
+		std::lock_guard<std::mutex> writeLock{m_WriteMutex};
+		auto temporary = m_Path + ".snapshot.tmp";
+		int file = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		RecordWriter header;
+		header.Put(m_Sequence).Put(Checksum(m_Sequence, payload.data(), payload.size()));
+		bool written = file >= 0
+			&& WriteAll(file, header.Data().data(), header.Data().size())
+			&& WriteAll(file, payload.data(), payload.size())
+			&& ::fsync(file) == 0;
+		if (file >= 0) {
+			::close(file);
+		}
+		if (!written || std::rename(temporary.c_str(), (m_Path + ".snapshot").c_str()) != 0) {
+			std::cout << "[Journal] Cannot write the snapshot.\n";
+			return;
+		}
+		// The rename is durable once the directory is synced.
+		auto slash = m_Path.rfind('/');
+		int directory = ::open(slash == std::string::npos ? "." : m_Path.substr(0, slash + 1).c_str(), O_RDONLY);
+		if (directory >= 0) {
+			::fsync(directory);
+			::close(directory);
+		}
+		// The records are all in the snapshot now.
+		if (::ftruncate(m_File, 0) == 0) {
+			::fsync(m_File);
+		}
+		m_SnapshotSequence = m_Sequence;
+	}
+};
@@ -0,0 +1,401 @@
+/*
+    A powerpoint like application where users can create slides and give presentation.
+
+
+
+    Issue with the design in 3_slide_deck_4.cpp :
+        - Every AddSlide(), ModifyTitle() and ModifyDescription() calls Display() of every view
+          at once. Importing a deck of 2000 slides, and then fixing up their titles, redraws
+          the views thousands of times, often for the same slide.
+        - The strings are copied on their way to the Slide.
+
+
+    - The Deck collects the changes made between BeginUpdate() and EndUpdate() in a DeckDiff
+      and notifies every view once, at the last EndUpdate() (the calls can be nested).
+      DeckUpdate does both, for the lifetime of a scope.
+    - The DeckDiff is compact : a sorted list of ranges of slides, with the fields that changed
+      in each. Adjacent ranges with the same fields are merged, so a slide modified 100 times
+      appears once, and 2000 new slides are one range. Where a change overlaps a range with
+      other fields, the range is split, so every slide has exactly the fields that changed.
+    - Outside BeginUpdate() / EndUpdate() every change is notified at once, as before.
+    - The views get the diff in Update(). The default Update() calls Display(index) for every
+      changed slide. Views which can redraw many slides at once, or which only need part of
+      the diff, override Update().
+    - The strings are taken by value and moved down to the Slide.
+
+*/
+
+
+//////////////////////////////////////////
+////////////////////////  Slide.h
+//////////////////////////////////////////
+#include <string>
+
+class Slide {
+    std::string m_Title;
+    std::string m_Description;
+public:
+    Slide() = default;
+
+    Slide(std::string mTitle, std::string mDesc) : m_Title{std::move(mTitle)}, m_Description{std::move(mDesc)} {}
+
+    void SetTitle(std::string title) {
+        m_Title = std::move(title);
+    }
+
+    void SetDescription(std::string desc) {
+        m_Description = std::move(desc);
+    }
+
+    const std::string& GetTitle() const {
+        return m_Title;
+    }
+
+    const std::string& GetDescription() const {
+        return m_Description;
+    }
+};
+
+//////////////////////////////////////////
+//////////////////////////////   DeckDiff.h
+//////////////////////////////////////////
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+// The slides changed during an update.
+class DeckDiff {
+public:
+    enum Field : uint8_t { Title = 1, Description = 2, Added = 4 };
+
+    struct Range {
+        size_t m_First;
+        size_t m_Last;          // one past the last slide
+        uint8_t m_Fields;       // Field flags
+    };
+private:
+    // Keyed by m_First. The ranges never overlap, and the ranges which touch have different fields.
+    std::map<size_t, Range> m_Ranges;
+
+    // The range overlaps none. It is merged with the neighbours which have the same fields.
+    void Insert(Range range) {
+        auto next = m_Ranges.lower_bound(range.m_First);
+        if (next != m_Ranges.end() && next->second.m_First == range.m_Last && next->second.m_Fields == range.m_Fields) {
+            range.m_Last = next->second.m_Last;
+            next = m_Ranges.erase(next);
+        }
+        if (next != m_Ranges.begin()) {
+            auto &previous = std::prev(next)->second;
+            if (previous.m_Last == range.m_First && previous.m_Fields == range.m_Fields) {
+                previous.m_Last = range.m_Last;
+                return;
+            }
+        }
+        m_Ranges.emplace_hint(next, range.m_First, range);
+    }
+public:
+    // The slides of [first, last) get the fields, in addition to those they already have.
+    // The ranges it overlaps are split where the fields differ.
+    void Add(size_t first, size_t last, uint8_t fields) {
+        if (first >= last) {
+            return;
+        }
+        std::vector<Range> pieces;
+        size_t pos = first;
+        auto it = m_Ranges.upper_bound(first);
+        if (it != m_Ranges.begin() && std::prev(it)->second.m_Last > first) {
+            --it;
+        }
+        while (it != m_Ranges.end() && it->second.m_First < last) {
+            const Range range = it->second;
+            if (range.m_First < pos) {
+                pieces.push_back({range.m_First, pos, range.m_Fields});
+            }
+            else if (pos < range.m_First) {
+                pieces.push_back({pos, range.m_First, fields});
+            }
+            size_t overlapLast = std::min(range.m_Last, last);
+            pieces.push_back({std::max(range.m_First, pos), overlapLast, static_cast<uint8_t>(range.m_Fields | fields)});
+            if (range.m_Last > last) {
+                pieces.push_back({last, range.m_Last, range.m_Fields});
+            }
+            pos = overlapLast;
+            it = m_Ranges.erase(it);
+        }
+        if (pos < last) {
+            pieces.push_back({pos, last, fields});
+        }
+        for (auto &piece : pieces) {
+            Insert(piece);
+        }
+    }
+
+    bool Empty() const { return m_Ranges.empty(); }
+
+    void Clear() { m_Ranges.clear(); }
+
+    size_t RangeCount() const { return m_Ranges.size(); }
+
+    // Calls fn(const Range&) in increasing order of slides.
+    template <typename Fn>
+    void ForEachRange(Fn fn) const {
+        for (auto &entry : m_Ranges) {
+            fn(entry.second);
+        }
+    }
+
+    // Calls fn(index, fields) for every changed slide.
+    template <typename Fn>
+    void ForEachSlide(Fn fn) const {
+        for (auto &entry : m_Ranges) {
+            for (size_t index = entry.second.m_First; index < entry.second.m_Last; ++index) {
+                fn(index, entry.second.m_Fields);
+            }
+        }
+    }
+};
+
+//////////////////////////////////////////
+//////////////////////////////   View.h
+//////////////////////////////////////////
+class View {
+public:
+    virtual void Display(size_t index) = 0;
+
+    virtual void Update(const DeckDiff &diff) {
+        diff.ForEachSlide([this](size_t index, uint8_t) { Display(index); });
+    }
+
+    virtual ~View() = default;
+};
+
+// holds slides
+//////////////////////////////////////////
+////////////////////////  Deck.h
+//////////////////////////////////////////
+#include <vector>
+#include <list>
+#include <memory>
+
+using SlidePtr = std::shared_ptr<Slide>;
+
+class Deck {
+    std::vector<SlidePtr> m_Slides;
+    std::list<View*> m_Views;
+    int m_UpdateDepth{};
+    DeckDiff m_Diff;
+
+    void Changed(size_t first, size_t last, uint8_t fields) {
+        m_Diff.Add(first, last, fields);
+        if (m_UpdateDepth == 0) {
+            Notify();
+        }
+    }
+public:
+    void Attach(View *pView) {
+        m_Views.push_back(pView);
+    }
+
+    void Detach(View *pView) {
+        m_Views.remove(pView);
+    }
+
+    // The diff is cleared first, so a view may modify the deck from Update().
+    void Notify() {
+        if (m_Diff.Empty()) {
+            return;
+        }
+        DeckDiff diff;
+        std::swap(diff, m_Diff);
+        for (auto view : m_Views) {
+            view->Update(diff);
+        }
+    }
+
+    void BeginUpdate() {
+        ++m_UpdateDepth;
+    }
+
+    void EndUpdate() {
+        if (m_UpdateDepth > 0 && --m_UpdateDepth == 0) {
+            Notify();
+        }
+    }
+
+    void Reserve(size_t count) {
+        m_Slides.reserve(count);
+    }
+
+    void AddSlide(SlidePtr slide) {
+        m_Slides.push_back(std::move(slide));
+        Changed(m_Slides.size() - 1, m_Slides.size(), DeckDiff::Added | DeckDiff::Title | DeckDiff::Description);
+    }
+
+    void ModifyTitle(size_t index, std::string title) {
+        if (index >= m_Slides.size()) return;
+        m_Slides[index]->SetTitle(std::move(title));
+        Changed(index, index + 1, DeckDiff::Title);
+    }
+
+    void ModifyDescription(size_t index, std::string desc) {
+        if (index >= m_Slides.size()) return;
+        m_Slides[index]->SetDescription(std::move(desc));
+        Changed(index, index + 1, DeckDiff::Description);
+    }
+
+    size_t Size() const {
+        return m_Slides.size();
+    }
+
+    SlidePtr GetAt(size_t index) const {
+        if (index >= m_Slides.size())
+            return nullptr;
+        return m_Slides[index];
+    }
+};
+
+// The changes made during the lifetime of a DeckUpdate are notified once.
+class DeckUpdate {
+    Deck &m_Deck;
+public:
+    explicit DeckUpdate(Deck &deck) : m_Deck{deck} {
+        m_Deck.BeginUpdate();
+    }
+    ~DeckUpdate() {
+        m_Deck.EndUpdate();
+    }
+    DeckUpdate(const DeckUpdate&) = delete;
+    DeckUpdate& operator=(const DeckUpdate&) = delete;
+};
+
+
+
+
+// Allows to add a new slide or modify content of a slide
+//////////////////////////////////////////
+////////////////////////  EditorView.h
+//////////////////////////////////////////
+#include <iostream>
+
+// Redraws every changed slide, with the default Update(). Counts the notifications and the redraws.
+class EditorView : public View {
+    Deck *m_pDeck;
+    size_t m_Updates{};
+    size_t m_Redraws{};
+public:
+    EditorView(Deck *pDeck) : m_pDeck(pDeck) {}
+
+    void Update(const DeckDiff &diff) override {
+        ++m_Updates;
+        View::Update(diff);
+    }
+
+    void Display(size_t) override {
+        // Drawing is expensive, here we only count.
+        ++m_Redraws;
+    }
+
+    size_t Updates() const { return m_Updates; }
+    size_t Redraws() const { return m_Redraws; }
+};
+
+
+//////////////////////////////////////////
+////////////////////////  SlideShowView.h
+//////////////////////////////////////////
+#include <iostream>
+
+// Shows one slide. Ignores the changes to the other slides.
+class SlideShowView  : public View {
+    Deck *m_pDeck;
+    size_t m_Current{};
+public:
+    SlideShowView(Deck *pDeck) : m_pDeck(pDeck) {}
+
+    void Show(size_t index) {
+        m_Current = index;
+        Display(index);
+    }
+
+    void Display(size_t index) override {
+        std::cout << "\n----------------------- SLIDE NO: " << index + 1 << " -----------------------\n";
+        std::cout << m_pDeck->GetAt(index)->GetTitle() << "\n";
+        std::cout << m_pDeck->GetAt(index)->GetDescription() << "\n";
+        std::cout << "---------------------------------------------------------------------\n";
+    }
+
+    void Update(const DeckDiff &diff) override {
+        std::cout << "[SLIDESHOW] " << diff.RangeCount() << " changed range(s) :";
+        bool current = false;
+        diff.ForEachRange([this, &current](const DeckDiff::Range &range) {
+            std::cout << " [" << range.m_First + 1 << ", " << range.m_Last << "]";
+            current = current || (range.m_First <= m_Current && m_Current < range.m_Last);
+        });
+        std::cout << "\n";
+        if (current) {
+            Display(m_Current);
+        }
+    }
+};
+
+
+
+
+
+
+// Imports a deck and then fixes up the titles of every 10th slide.
+void Import(Deck &deck, size_t count) {
+    deck.Reserve(deck.Size() + count);
+    size_t first = deck.Size();
+    for (size_t i = 0; i < count; ++i) {
+        deck.AddSlide(std::make_shared<Slide>("Slide " + std::to_string(first + i + 1), "Imported"));
+    }
+    for (size_t i = first; i < first + count; i += 10) {
+        deck.ModifyTitle(i, "Section " + std::to_string(i / 10 + 1));
+        deck.ModifyDescription(i, "Imported, renamed");
+    }
+}
+
+int main() {
+    Deck deck{};
+    EditorView ev{&deck};
+    deck.Attach(&ev);
+
+    {
+        DeckUpdate update{deck};
+        deck.AddSlide(std::make_shared<Slide>("Training", "C++ for beginners"));
+        deck.AddSlide(std::make_shared<Slide>("Objective", "Learn the basics of C++"));
+        deck.AddSlide(std::make_shared<Slide>("What is C++", "C++ is a general programming language"));
+    }
+
+    SlideShowView sv(&deck);
+    deck.Attach(&sv);
+    sv.Show(2);
+
+    std::cout << "\nModifying slide #3\n";
+    deck.ModifyTitle(2, "Overview");
+
+    // Without batching every change is drawn at once.
+    deck.Detach(&sv);
+    size_t updates = ev.Updates();
+    size_t redraws = ev.Redraws();
+    Import(deck, 2000);
+    std::cout << "\nImport of 2000 slides without an update : " << ev.Updates() - updates << " notifications, "
+              << ev.Redraws() - redraws << " redraws\n";
+
+    // With batching the views are notified once, at the end.
+    deck.Attach(&sv);
+    updates = ev.Updates();
+    redraws = ev.Redraws();
+    {
+        DeckUpdate update{deck};
+        Import(deck, 2000);
+        deck.ModifyDescription(2, "C++ is a general purpose programming language");
+    }
+    std::cout << "Import of 2000 slides in an update : " << ev.Updates() - updates << " notification, "
+              << ev.Redraws() - redraws << " redraws\n";
+
+    return 0;
+}
@@ -0,0 +1,294 @@
+/*
+    Temperature Sensor with delivery policies
+
+    In 4_sensor_2.cpp the observers register for SMALL or LARGE changes. SMALL observers get
+    every reading, LARGE observers get the readings which differ by more than 0.5 from the
+    previous reading. A sensor which sends a thousand readings per second wakes the observers
+    a thousand times per second, even those which only show a trend.
+
+    Now every observer registers with a DeliveryPolicy, which the sensor applies for it :
+     - m_Deadband     : a reading is dropped if it differs by less than m_Deadband from the last
+                        reading kept for this observer. (The LARGE category was a deadband of 0.5,
+                        measured against the previous reading, so a slow drift was never seen.)
+     - m_MinInterval  : the observer is notified at most once per m_MinInterval. The readings which
+                        arrive in between are kept and delivered with the next notification.
+     - m_Coalesce     : only the latest kept reading is delivered, the older ones are discarded.
+     - m_BatchSize    : the observer is notified when at least m_BatchSize readings are kept,
+                        all of them in one call.
+    The default policy delivers every reading at once, as before.
+
+    The readings are delivered with NotifyBatch(). Observers which want one reading at a time
+    override Notify() only, the default NotifyBatch() calls it for each reading.
+
+    There is no timer : kept readings are delivered by the next SetTemp() or by Flush(), which
+    the owner of the sensor calls periodically.
+
+
+		---------------------		m_Subscriptions                 ---------------------
+		| TemperatureSensor |-------------------------------------->|  OnValueChanged   |
+		---------------------	 (observer + policy + pending)      ---------------------
+		| Register(View*,   |				                                /_\
+		|          Policy)  |		                                         |
+		| Deregister(View*) |                                     	         |
+		| SetTemp()         |                                     	         |
+		| Flush()           |                                     	         |
+		---------------------                  	            	             |
+                                     ________________________________________|________________________________
+                                     |                        |                        |                     |
+                         ---------------------   ---------------------   ---------------------   ---------------------
+                         | Recorder          |   | SimpleDisplay     |   | Billboard         |   | TrendAnalyzer     |
+                         ---------------------   ---------------------   ---------------------   ---------------------
+*/
+
+// Observer
+///////////////////////////////////////////
+////////////////////////  OnValuechanged.h
+///////////////////////////////////////////
+#include <cstddef>
+class OnValuechanged {
+public:
+    virtual void Notify(float value) = 0;
+    // The readings kept since the last notification, oldest first.
+    virtual void NotifyBatch(const float *pValues, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Notify(pValues[i]);
+        }
+    }
+    virtual ~OnValuechanged() = default;
+};
+
+
+//////////////////////////////////////////////
+////////////////////////  DeliveryPolicy.h
+//////////////////////////////////////////////
+#include <chrono>
+
+struct DeliveryPolicy {
+    float m_Deadband{0.0f};
+    std::chrono::milliseconds m_MinInterval{0};
+    bool m_Coalesce{false};
+    size_t m_BatchSize{1};
+
+    static DeliveryPolicy Every() { return {}; }
+    static DeliveryPolicy Deadband(float band) { return {band, std::chrono::milliseconds{0}, false, 1}; }
+    static DeliveryPolicy Latest(std::chrono::milliseconds interval) { return {0.0f, interval, true, 1}; }
+    static DeliveryPolicy Batch(size_t size) { return {0.0f, std::chrono::milliseconds{0}, false, size}; }
+};
+
+
+// Subject
+//////////////////////////////////////////////
+////////////////////////  TemperatureSensor.h
+//////////////////////////////////////////////
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+class TemperatureSensor {
+public:
+    using Clock = std::chrono::steady_clock;
+private:
+    struct Subscription {
+        OnValuechanged *m_pSub;
+        DeliveryPolicy m_Policy;
+        std::vector<float> m_Pending;
+        bool m_HasReference{false};
+        float m_Reference{};                // the last reading kept, for the deadband
+        bool m_Delivered{false};
+        Clock::time_point m_LastDelivery{};
+        size_t m_Notifications{};
+    };
+
+    std::vector<Subscription> m_Subscriptions;
+    float m_Temp{};
+
+    static bool IntervalElapsed(const Subscription &s, Clock::time_point now) {
+        return !s.m_Delivered || now - s.m_LastDelivery >= s.m_Policy.m_MinInterval;
+    }
+
+    static void Deliver(Subscription &s, Clock::time_point now) {
+        // m_Pending may be appended to by a reentrant SetTemp(), deliver a copy.
+        std::vector<float> values;
+        values.swap(s.m_Pending);
+        s.m_Delivered = true;
+        s.m_LastDelivery = now;
+        ++s.m_Notifications;
+        s.m_pSub->NotifyBatch(values.data(), values.size());
+    }
+
+    static void Offer(Subscription &s, float value, Clock::time_point now) {
+        auto &policy = s.m_Policy;
+        if (s.m_HasReference && std::fabs(value - s.m_Reference) < policy.m_Deadband) {
+            return;
+        }
+        s.m_HasReference = true;
+        s.m_Reference = value;
+        if (policy.m_Coalesce) {
+            s.m_Pending.clear();
+        }
+        s.m_Pending.push_back(value);
+        if (s.m_Pending.size() >= policy.m_BatchSize && IntervalElapsed(s, now)) {
+            Deliver(s, now);
+        }
+    }
+
+    auto Find(OnValuechanged *pSub) {
+        return std::find_if(begin(m_Subscriptions), end(m_Subscriptions),
+                            [pSub](const Subscription &s) { return s.m_pSub == pSub; });
+    }
+public:
+    // Registering again replaces the policy.
+    void Register(OnValuechanged *pSub, DeliveryPolicy policy = DeliveryPolicy::Every()) {
+        auto it = Find(pSub);
+        if (it != end(m_Subscriptions)) {
+            it->m_Policy = policy;
+            return;
+        }
+        m_Subscriptions.push_back({pSub, policy});
+    }
+
+    // The readings not delivered yet are discarded.
+    void Deregister(OnValuechanged *pSub) {
+        auto it = Find(pSub);
+        if (it != end(m_Subscriptions)) {
+            m_Subscriptions.erase(it);
+        }
+    }
+
+    void SetTemp(float value, Clock::time_point now = Clock::now()) {
+        m_Temp = value;
+        for (auto &s : m_Subscriptions) {
+            Offer(s, value, now);
+        }
+    }
+
+    // Delivers the readings whose interval has elapsed. With partialBatches the batches which
+    // are not full are delivered too, e.g. when the sensor stops.
+    void Flush(Clock::time_point now = Clock::now(), bool partialBatches = false) {
+        for (auto &s : m_Subscriptions) {
+            if (s.m_Pending.empty() || !IntervalElapsed(s, now)) {
+                continue;
+            }
+            if (partialBatches || s.m_Pending.size() >= s.m_Policy.m_BatchSize) {
+                Deliver(s, now);
+            }
+        }
+    }
+
+    float GetTemp() const { return m_Temp; }
+
+    size_t Notifications(OnValuechanged *pSub) {
+        auto it = Find(pSub);
+        return it != end(m_Subscriptions) ? it->m_Notifications : 0;
+    }
+};
+
+
+
+
+///////////////////////////////////////
+////////////////////////   Billboard.h
+///////////////////////////////////////
+#include <iostream>
+class Billboard : public OnValuechanged {
+public:
+    void Notify(float value) override {
+        std::cout << "[BILLBOARD] " << value << "\n";
+    }
+};
+
+
+
+///////////////////////////////////////
+////////////////////////   Recorder.h
+///////////////////////////////////////
+#include <iostream>
+class Recorder : public OnValuechanged {
+    size_t m_Readings{};
+public:
+    void Notify(float) override {
+        ++m_Readings;
+    }
+    size_t Readings() const { return m_Readings; }
+};
+
+
+///////////////////////////////////////////
+////////////////////////   SimpleDisplay.h
+///////////////////////////////////////////
+#include <iostream>
+class SimpleDisplay : public OnValuechanged {
+    float m_Shown{};
+public:
+    void Notify(float value) override {
+        m_Shown = value;
+    }
+    float Shown() const { return m_Shown; }
+};
+
+
+///////////////////////////////////////////
+////////////////////////   TrendAnalyzer.h
+///////////////////////////////////////////
+#include <iostream>
+// Only looks at the average of many readings.
+class TrendAnalyzer : public OnValuechanged {
+    bool m_HasPrevious{false};
+    float m_Previous{};
+public:
+    void Notify(float value) override {
+        NotifyBatch(&value, 1);
+    }
+
+    void NotifyBatch(const float *pValues, size_t count) override {
+        float sum{};
+        for (size_t i = 0; i < count; ++i) {
+            sum += pValues[i];
+        }
+        float average = sum / count;
+        std::cout << "[TREND] average of " << count << " readings : " << average;
+        if (m_HasPrevious) {
+            std::cout << (average > m_Previous ? "  rising" : "  falling");
+        }
+        std::cout << "\n";
+        m_HasPrevious = true;
+        m_Previous = average;
+    }
+};
+
+
+
+
+
+int main() {
+    TemperatureSensor sensor;
+    Billboard bb;
+    SimpleDisplay sd;
+    Recorder rec;
+    TrendAnalyzer trend;
+
+    sensor.Register(&bb, DeliveryPolicy::Latest(std::chrono::seconds{1}));
+    sensor.Register(&sd, DeliveryPolicy::Deadband(0.5f));
+    sensor.Register(&rec);
+    sensor.Register(&trend, DeliveryPolicy::Batch(1000));
+
+    // 5 seconds of readings, one per millisecond : a slow warming with some noise.
+    auto start = TemperatureSensor::Clock::now();
+    unsigned noise = 12345;
+    for (int ms = 0; ms < 5000; ++ms) {
+        noise = noise * 1103515245u + 12345u;
+        float jitter = static_cast<float>((noise >> 16) % 100) / 250.0f - 0.2f;
+        auto now = start + std::chrono::milliseconds{ms};
+        sensor.SetTemp(20.0f + ms / 1000.0f + jitter, now);
+        sensor.Flush(now);
+    }
+    sensor.Flush(start + std::chrono::seconds{5}, true);
+
+    std::cout << "Readings : 5000\n"
+              << "  recorder       : " << sensor.Notifications(&rec) << " notifications\n"
+              << "  simple display : " << sensor.Notifications(&sd) << " notifications, showing " << sd.Shown() << "\n"
+              << "  billboard      : " << sensor.Notifications(&bb) << " notifications\n"
+              << "  trend analyzer : " << sensor.Notifications(&trend) << " notifications\n";
+
+    return 0;
+}
@@ -0,0 +1,554 @@
+/*
+    Asynchronous change manager.
+
+    In 5_change_manager.cpp the sensor calls ChangeManager::Notify() which calls every observer
+    on the sensor's thread. A slow observer (a billboard which takes a millisecond to redraw)
+    slows the sensor down, and with hundreds of thousands of readings per second the sensors
+    spend their time waiting for the observers.
+    Also Notify() and DeRegister() use m_Mapping[pSensor], which inserts an empty list for
+    an unknown sensor.
+
+    Now the ChangeManager has two modes.
+    - ChangeManager{}   : synchronous, as before. Publish() calls the observers at once.
+    - ChangeManager{n}  : asynchronous, with n dispatcher threads.
+      - Each sensor gets its own Channel : a single producer / single consumer ring buffer.
+        Publish() copies the reading (sensor and value) into the ring and returns.
+        No lock, no allocation, no wait. If the ring is full the reading is dropped
+        (and counted), the sensor is never blocked.
+      - Each channel is read by one dispatcher thread. A dispatcher takes up to BatchSize
+        readings from a ring at once and calls the observers for each of them.
+      - The observers are called on the dispatcher threads. An observer which is
+        registered with sensors of different dispatchers must be thread safe.
+    - The mapping from sensor to observers is immutable. Register() and DeRegister() build a new
+      mapping and swap it in. The dispatchers read it once per round, without a lock.
+    - Each dispatcher publishes the generation it has seen at the start of a round. DeRegister()
+      bumps the generation after the swap and waits until every dispatcher has seen it, so once it
+      returns no dispatcher still uses the old mapping and the observer can be deleted.
+    - The sensor closes its channel in its destructor, the same way. The readings not delivered
+      yet are discarded, and the slot is reused by the next OpenChannel(). If all MaxChannels
+      slots are in use OpenChannel() reports it, and the readings of that sensor are dropped.
+    - The observers get the value in the notification. By the time a dispatcher calls
+      them the sensor may have a newer value already.
+
+            ---------------------  Publish()  -------------   PopBatch()  --------------  Notify()  ------------------
+            | TemperatureSensor |------------>|  Channel  |-------------->| dispatcher |---------->| OnValueChanged |
+            ---------------------             | (ring)    |               | thread     |           ------------------
+                                              -------------               --------------
+*/
+
+// Subject
+/////////////////////////////////////////////
+/////////////////////        Sensor.h
+/////////////////////////////////////////////
+class Sensor {
+public:
+    virtual float GetValue() const = 0;
+    virtual void Notify() = 0;
+    virtual ~Sensor() = default;
+};
+
+// Observer
+///////////////////////////////////////////
+////////////////////////  OnValuechanged.h
+///////////////////////////////////////////
+class OnValueChanged {
+public:
+    //  The value is the one the sensor published.
+    virtual void Notify(Sensor *pSensor, float value) = 0;
+    virtual ~OnValueChanged() = default;
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        SpscRing.h
+/////////////////////////////////////////////
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+// Ring buffer for one producer thread and one consumer thread.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+    static constexpr size_t CacheLine = 64;
+
+    T m_Items[Capacity];
+    // The padding keeps the indices of the producer and of the consumer on different cache lines.
+    char m_Pad0[CacheLine];
+    std::atomic<size_t> m_Tail{0};      // written by the producer
+    size_t m_CachedHead{0};             // the producer's copy of m_Head
+    char m_Pad1[CacheLine];
+    std::atomic<size_t> m_Head{0};      // written by the consumer
+    size_t m_CachedTail{0};             // the consumer's copy of m_Tail
+    char m_Pad2[CacheLine];
+public:
+    // Producer only. Returns false if the ring is full.
+    bool TryPush(const T &item) {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_CachedHead == Capacity) {
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+            if (tail - m_CachedHead == Capacity) {
+                return false;
+            }
+        }
+        m_Items[tail & (Capacity - 1)] = item;
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Copies up to maxCount items to pItems, returns how many.
+    size_t PopBatch(T *pItems, size_t maxCount) {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (m_CachedTail == head) {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(maxCount, m_CachedTail - head);
+        for (size_t i = 0; i < count; ++i) {
+            pItems[i] = m_Items[(head + i) & (Capacity - 1)];
+        }
+        m_Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Empties the ring. Neither the producer nor the consumer may be using it.
+    void Reset() {
+        m_Tail.store(0, std::memory_order_relaxed);
+        m_CachedHead = 0;
+        m_Head.store(0, std::memory_order_relaxed);
+        m_CachedTail = 0;
+    }
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        ChangeManager.h
+/////////////////////////////////////////////
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <iostream>
+
+struct Reading {
+    Sensor *m_pSensor;
+    float m_Value;
+};
+
+// One per sensor. The counters have a single writer each.
+struct Channel {
+    SpscRing<Reading, 4096> m_Ring;
+    std::atomic<size_t> m_Published{0};     // written by the sensor
+    std::atomic<size_t> m_Dropped{0};       // written by the sensor
+    std::atomic<size_t> m_Delivered{0};     // written by the dispatcher
+    std::atomic<bool> m_Open{false};        // the dispatcher skips the closed channels
+    size_t m_Slot{};
+};
+
+class ChangeManager {
+    using Observers = std::vector<OnValueChanged*>;
+    using Mapping = std::unordered_map<Sensor*, Observers>;
+
+    // Never changed once published. Read with std::atomic_load.
+    std::shared_ptr<const Mapping> m_pMapping{std::make_shared<Mapping>()};
+    std::mutex m_RegisterMutex;
+
+    static constexpr size_t MaxChannels = 256;
+    static constexpr size_t BatchSize = 64;
+    // A slot is allocated once and reused after its channel is closed.
+    std::unique_ptr<Channel> m_Channels[MaxChannels];
+    std::atomic<size_t> m_ChannelCount{0};      // slots allocated so far
+    std::vector<size_t> m_FreeSlots;
+    std::mutex m_ChannelMutex;                  // not taken by the dispatchers
+    const size_t m_DispatcherCount;
+    std::vector<std::thread> m_Dispatchers;
+    std::atomic<bool> m_Stop{false};
+
+    // The generation each dispatcher saw at the start of its current round.
+    struct DispatcherState {
+        std::atomic<uint64_t> m_Seen{0};
+        char m_Pad[64];
+    };
+    static constexpr uint64_t Stopped = std::numeric_limits<uint64_t>::max();
+    std::atomic<uint64_t> m_Generation{0};
+    std::unique_ptr<DispatcherState[]> m_States;
+
+    // Returns once every dispatcher has started a round after the mapping or a channel changed.
+    // A dispatcher does not wait for itself, an observer may call DeRegister().
+    void WaitForDispatchers() {
+        uint64_t generation = m_Generation.fetch_add(1) + 1;
+        for (size_t d = 0; d < m_DispatcherCount; ++d) {
+            if (m_Dispatchers[d].get_id() == std::this_thread::get_id()) {
+                continue;
+            }
+            while (m_States[d].m_Seen.load() < generation) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Calls fn(mapping) with a copy of the mapping and publishes the result.
+    template <typename Fn>
+    void Update(Fn fn) {
+        std::lock_guard<std::mutex> lock{m_RegisterMutex};
+        auto pMapping = std::make_shared<Mapping>(*m_pMapping);
+        fn(*pMapping);
+        std::atomic_store(&m_pMapping, std::shared_ptr<const Mapping>{std::move(pMapping)});
+    }
+
+    static void Deliver(const Mapping &mapping, const Reading &reading) {
+        auto it = mapping.find(reading.m_pSensor);
+        if (it == mapping.end()) {
+            return;
+        }
+        for (auto ob : it->second) {
+            ob->Notify(reading.m_pSensor, reading.m_Value);
+        }
+    }
+
+    // Dispatcher d reads the channels d, d + n, d + 2n ...
+    void Dispatch(size_t d) {
+        Reading batch[BatchSize];
+        unsigned idleRounds = 0;
+        while (true) {
+            bool stopping = m_Stop.load(std::memory_order_acquire);
+            // Published before the mapping and the channels are read.
+            m_States[d].m_Seen.store(m_Generation.load());
+            auto pMapping = std::atomic_load(&m_pMapping);
+            size_t delivered = 0;
+            size_t channels = m_ChannelCount.load(std::memory_order_acquire);
+            for (size_t i = d; i < channels; i += m_DispatcherCount) {
+                auto &channel = *m_Channels[i];
+                if (!channel.m_Open.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                size_t count = channel.m_Ring.PopBatch(batch, BatchSize);
+                for (size_t r = 0; r < count; ++r) {
+                    Deliver(*pMapping, batch[r]);
+                }
+                channel.m_Delivered.store(channel.m_Delivered.load(std::memory_order_relaxed) + count,
+                                          std::memory_order_release);
+                delivered += count;
+            }
+            if (delivered > 0) {
+                idleRounds = 0;
+                continue;
+            }
+            // Everything published before the stop has been delivered.
+            if (stopping) {
+                m_States[d].m_Seen.store(Stopped);
+                return;
+            }
+            // Nothing to do. Spin a little, then sleep.
+            if (++idleRounds < 64) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::microseconds{100});
+            }
+        }
+    }
+public:
+    // dispatchers == 0 : the observers are called by Publish(), on the sensor's thread.
+    explicit ChangeManager(size_t dispatchers = 0)
+        : m_DispatcherCount{dispatchers}, m_States{new DispatcherState[dispatchers]} {
+        m_Dispatchers.reserve(dispatchers);
+        for (size_t d = 0; d < dispatchers; ++d) {
+            m_Dispatchers.emplace_back(&ChangeManager::Dispatch, this, d);
+        }
+    }
+
+    ~ChangeManager() {
+        m_Stop.store(true, std::memory_order_release);
+        for (auto &dispatcher : m_Dispatchers) {
+            dispatcher.join();
+        }
+    }
+
+    ChangeManager(const ChangeManager&) = delete;
+    ChangeManager& operator=(const ChangeManager&) = delete;
+
+    bool IsAsync() const { return m_DispatcherCount > 0; }
+
+    // Every sensor opens its channel once, from any thread, and closes it before it is destroyed.
+    // Returns nullptr if all the slots are in use, and in the synchronous mode, which needs none.
+    Channel* OpenChannel() {
+        if (!IsAsync()) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock{m_ChannelMutex};
+        Channel *pChannel{};
+        if (!m_FreeSlots.empty()) {
+            pChannel = m_Channels[m_FreeSlots.back()].get();
+            m_FreeSlots.pop_back();
+        }
+        else {
+            size_t index = m_ChannelCount.load(std::memory_order_relaxed);
+            if (index == MaxChannels) {
+                std::cerr << "ChangeManager : all " << MaxChannels
+                          << " channels are in use, the readings of this sensor are dropped\n";
+                return nullptr;
+            }
+            m_Channels[index].reset(new Channel);
+            m_Channels[index]->m_Slot = index;
+            m_ChannelCount.store(index + 1, std::memory_order_release);
+            pChannel = m_Channels[index].get();
+        }
+        pChannel->m_Open.store(true, std::memory_order_release);
+        return pChannel;
+    }
+
+    // The readings not delivered yet are discarded. Once it returns the dispatchers no longer
+    // read the channel, and it is reused.
+    void CloseChannel(Channel *pChannel) {
+        if (!pChannel) {
+            return;
+        }
+        pChannel->m_Open.store(false, std::memory_order_release);
+        WaitForDispatchers();
+        std::lock_guard<std::mutex> lock{m_ChannelMutex};
+        pChannel->m_Ring.Reset();
+        pChannel->m_Published.store(0, std::memory_order_relaxed);
+        pChannel->m_Dropped.store(0, std::memory_order_relaxed);
+        pChannel->m_Delivered.store(0, std::memory_order_relaxed);
+        m_FreeSlots.push_back(pChannel->m_Slot);
+    }
+
+    void Register(Sensor *pSensor, OnValueChanged *pValueChanged) {
+        Update([=](Mapping &mapping) { mapping[pSensor].push_back(pValueChanged); });
+    }
+
+    // Once it returns the observer is not called any more, by any dispatcher.
+    void DeRegister(Sensor *pSensor, OnValueChanged *pValueChanged) {
+        Update([=](Mapping &mapping) {
+            auto it = mapping.find(pSensor);
+            if (it == mapping.end()) {
+                return;
+            }
+            auto &observers = it->second;
+            observers.erase(std::remove(begin(observers), end(observers), pValueChanged), end(observers));
+            if (observers.empty()) {
+                mapping.erase(it);
+            }
+        });
+        WaitForDispatchers();
+    }
+
+    // Called by the sensor, on its own thread. Never blocks in the asynchronous mode.
+    // Without a channel the reading is dropped, OpenChannel() has reported it.
+    void Publish(Channel *pChannel, Sensor *pSensor, float value) {
+        if (!IsAsync()) {
+            Deliver(*std::atomic_load(&m_pMapping), {pSensor, value});
+            return;
+        }
+        if (!pChannel) {
+            return;
+        }
+        pChannel->m_Published.store(pChannel->m_Published.load(std::memory_order_relaxed) + 1,
+                                    std::memory_order_relaxed);
+        if (!pChannel->m_Ring.TryPush({pSensor, value})) {
+            pChannel->m_Dropped.store(pChannel->m_Dropped.load(std::memory_order_relaxed) + 1,
+                                      std::memory_order_relaxed);
+        }
+    }
+
+    // Waits until the readings published so far have been delivered or dropped.
+    // The channels are not opened or closed meanwhile.
+    void Flush() {
+        std::lock_guard<std::mutex> lock{m_ChannelMutex};
+        size_t channels = m_ChannelCount.load(std::memory_order_acquire);
+        for (size_t i = 0; i < channels && IsAsync(); ++i) {
+            auto &channel = *m_Channels[i];
+            if (!channel.m_Open.load(std::memory_order_acquire)) {
+                continue;
+            }
+            size_t expected = channel.m_Published.load(std::memory_order_relaxed)
+                            - channel.m_Dropped.load(std::memory_order_relaxed);
+            while (channel.m_Delivered.load(std::memory_order_acquire) < expected) {
+                std::this_thread::sleep_for(std::chrono::microseconds{100});
+            }
+        }
+    }
+};
+
+
+
+
+
+//////////////////////////////////////////////
+////////////////////////  TemperatureSensor.h
+//////////////////////////////////////////////
+class TemperatureSensor : public Sensor {
+    float m_Temp{};
+    ChangeManager *m_pMgr;
+    Channel *m_pChannel;
+public:
+    TemperatureSensor(ChangeManager *pMgr) : m_pMgr{pMgr}, m_pChannel{pMgr->OpenChannel()} {}
+
+    ~TemperatureSensor() {
+        m_pMgr->CloseChannel(m_pChannel);
+    }
+
+    TemperatureSensor(const TemperatureSensor&) = delete;
+    TemperatureSensor& operator=(const TemperatureSensor&) = delete;
+
+    void Notify() override {
+        m_pMgr->Publish(m_pChannel, this, m_Temp);
+    }
+
+    void SetTemp(float value) {
+        m_Temp = value;
+        Notify();
+    }
+
+    float GetValue() const override {
+        return m_Temp;
+    }
+
+    // nullptr in the synchronous mode.
+    const Channel* GetChannel() const { return m_pChannel; }
+};
+
+
+
+//////////////////////////////////////////////
+////////////////////////  WindSpeedSensor.h
+//////////////////////////////////////////////
+class WindSpeedSensor : public Sensor {
+    float m_Speed{};
+    ChangeManager *m_pMgr;
+    Channel *m_pChannel;
+public:
+    WindSpeedSensor(ChangeManager *pMgr) : m_pMgr{pMgr}, m_pChannel{pMgr->OpenChannel()} {}
+
+    ~WindSpeedSensor() {
+        m_pMgr->CloseChannel(m_pChannel);
+    }
+
+    WindSpeedSensor(const WindSpeedSensor&) = delete;
+    WindSpeedSensor& operator=(const WindSpeedSensor&) = delete;
+
+    void Notify() override {
+        m_pMgr->Publish(m_pChannel, this, m_Speed);
+    }
+
+    // to simulate the change in wind speed.
+    void SetSpeed(float value) {
+        m_Speed = value;
+        Notify();
+    }
+
+    float GetValue() const override {
+        return m_Speed;
+    }
+
+    // nullptr in the synchronous mode.
+    const Channel* GetChannel() const { return m_pChannel; }
+};
+
+
+
+
+///////////////////////////////////////
+////////////////////////   Billboard.h
+///////////////////////////////////////
+#include <iostream>
+// Slow : redrawing takes a millisecond, so it redraws once per 1000 readings.
+class Billboard : public OnValueChanged {
+    std::atomic<size_t> m_Readings{0};
+public:
+    void Notify(Sensor *, float) override {
+        if (m_Readings.fetch_add(1, std::memory_order_relaxed) % 1000 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+    size_t Readings() const { return m_Readings; }
+};
+
+
+
+///////////////////////////////////////
+////////////////////////   Recorder.h
+///////////////////////////////////////
+class Recorder : public OnValueChanged {
+    std::atomic<size_t> m_Readings{0};
+public:
+    void Notify(Sensor *, float) override {
+        m_Readings.fetch_add(1, std::memory_order_relaxed);
+    }
+    size_t Readings() const { return m_Readings; }
+};
+
+
+///////////////////////////////////////////
+////////////////////////   SimpleDisplay.h
+///////////////////////////////////////////
+class SimpleDisplay : public OnValueChanged {
+    std::atomic<size_t> m_Readings{0};
+public:
+    void Notify(Sensor *, float) override {
+        m_Readings.fetch_add(1, std::memory_order_relaxed);
+    }
+    size_t Readings() const { return m_Readings; }
+};
+
+
+
+
+
+constexpr int ReadingsPerSensor = 200000;
+
+// Both sensors publish on their own thread, as fast as they can. Returns the time the sensors were busy.
+// In the asynchronous mode the observers cannot keep up with that, so most readings are dropped,
+// but the sensors finish without waiting for the billboard.
+double Run(size_t dispatchers) {
+    ChangeManager mgr{dispatchers};
+    TemperatureSensor sensor{&mgr};
+    WindSpeedSensor windSensor{&mgr};
+
+    Billboard bb;
+    SimpleDisplay sd;
+    Recorder rec;
+
+    mgr.Register(&sensor, &bb);
+    mgr.Register(&sensor, &sd);
+    mgr.Register(&sensor, &rec);
+
+    mgr.Register(&windSensor, &bb);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread temperature{[&sensor]() {
+        for (int i = 0; i < ReadingsPerSensor; ++i) {
+            sensor.SetTemp(20.0f + i % 100 / 10.0f);
+        }
+    }};
+    std::thread wind{[&windSensor]() {
+        for (int i = 0; i < ReadingsPerSensor; ++i) {
+            windSensor.SetSpeed(static_cast<float>(i % 80));
+        }
+    }};
+    temperature.join();
+    wind.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    mgr.Flush();
+
+    std::cout << (mgr.IsAsync() ? "Asynchronous, " : "Synchronous, ") << dispatchers << " dispatchers\n"
+              << "  sensors busy for " << seconds * 1000 << " ms\n"
+              << "  billboard : " << bb.Readings() << "  display : " << sd.Readings()
+              << "  recorder : " << rec.Readings() << " readings\n";
+    if (mgr.IsAsync()) {
+        std::cout << "  dropped : temperature " << sensor.GetChannel()->m_Dropped
+                  << ", wind " << windSensor.GetChannel()->m_Dropped << "\n";
+    }
+    return seconds;
+}
+
+int main() {
+    Run(0);
+    Run(2);
+
+    return 0;
+}
@@ -0,0 +1,518 @@
+/*
+    Change manager with topics.
+
+    In 5_change_manager.cpp the observers register for one Sensor* at a time. With tens of
+    thousands of sensors an observer which wants "all the wind sensors of zone 4" has to find
+    them and register with each, and has to register again for every sensor added later.
+
+    Now every sensor publishes on a topic, a path of segments :
+            zone4/wind/17           zone7/temperature/42
+    and the observers subscribe to patterns :
+            zone7/temperature/42    one sensor
+            zone4/wind/+            '+' matches any one segment
+            zone4/#                 '#' (last segment only) matches any number of segments, even none
+
+    - The segments are interned : each distinct segment string gets a number, so a topic is
+      a short array of integers.
+    - The patterns are kept in a trie of segments. A node has a child per segment, one child
+      for '+', and two sets of subscribers : those whose pattern ends at the node and those
+      whose pattern ends with '#' at the node. The sets are bitsets indexed by subscription.
+    - Routes are compiled : the first Notify() of a topic walks the trie with the segments of
+      the topic, ORs the matching bitsets and stores the matching observers in a list.
+      The following Notify() calls only walk that list, so their cost depends on the number of
+      observers of the topic, not on the number of sensors or of subscriptions.
+    - The topics are kept in a trie of segments too. Subscribe() and Unsubscribe() walk it with
+      the pattern and mark the routes of the matching topics only, which are compiled again by
+      their next Notify(). Subscribing to one sensor leaves the other routes alone.
+
+
+		                        ---------------------
+		      ;----m_Topics-----|   ChangeManager   |-----m_Root (trie)--------;
+		      |                 ---------------------                          |
+		     \|/                        /|\                                   \|/
+	   --------------------              |                          ------------------------
+	   | Topic            |              |                          | Node                 |
+	   | m_Segments       |           m_pMgr                        | m_Children  m_AnyOne |
+	   | m_Route          |              |                          | m_Here     m_AllBelow|
+	   --------------------     ---------------------               ------------------------
+	                            |      Sensor       |
+	                            ---------------------
+*/
+
+// Subject
+/////////////////////////////////////////////
+/////////////////////        Sensor.h
+/////////////////////////////////////////////
+#include <cstdint>
+#include <string>
+
+using TopicId = uint32_t;
+
+class Sensor {
+public:
+    virtual float GetValue() const = 0;
+    virtual TopicId GetTopic() const = 0;
+    virtual void Notify() = 0;
+    virtual ~Sensor() = default;
+};
+
+// Observer
+///////////////////////////////////////////
+////////////////////////  OnValuechanged.h
+///////////////////////////////////////////
+class OnValueChanged {
+public:
+    //  Using pSensor the Observers can know with Subject sent them the notification.
+    virtual void Notify(Sensor *pSensor) = 0;
+    virtual ~OnValueChanged() = default;
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        SubscriberSet.h
+/////////////////////////////////////////////
+#include <vector>
+
+// A bitset of subscription numbers, which grows as needed.
+class SubscriberSet {
+    std::vector<uint64_t> m_Words;
+public:
+    void Set(size_t index) {
+        if (index / 64 >= m_Words.size()) {
+            m_Words.resize(index / 64 + 1);
+        }
+        m_Words[index / 64] |= uint64_t{1} << (index % 64);
+    }
+
+    void Reset(size_t index) {
+        if (index / 64 < m_Words.size()) {
+            m_Words[index / 64] &= ~(uint64_t{1} << (index % 64));
+        }
+    }
+
+    SubscriberSet& operator|=(const SubscriberSet &other) {
+        if (other.m_Words.size() > m_Words.size()) {
+            m_Words.resize(other.m_Words.size());
+        }
+        for (size_t i = 0; i < other.m_Words.size(); ++i) {
+            m_Words[i] |= other.m_Words[i];
+        }
+        return *this;
+    }
+
+    // Calls fn(index) for every index in the set, in increasing order.
+    template <typename Fn>
+    void ForEach(Fn fn) const {
+        for (size_t i = 0; i < m_Words.size(); ++i) {
+            for (uint64_t word = m_Words[i]; word != 0; word &= word - 1) {
+                fn(i * 64 + static_cast<size_t>(__builtin_ctzll(word)));
+            }
+        }
+    }
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        ChangeManager.h
+/////////////////////////////////////////////
+#include <unordered_map>
+#include <memory>
+#include <iostream>
+
+using SubscriptionId = uint32_t;
+
+class ChangeManager {
+    using Segments = std::vector<uint32_t>;
+
+    struct Node {
+        std::unordered_map<uint32_t, std::unique_ptr<Node>> m_Children;
+        std::unique_ptr<Node> m_AnyOne;         // '+'
+        SubscriberSet m_Here;                   // patterns which end at this node
+        SubscriberSet m_AllBelow;               // patterns which end with '#' at this node
+    };
+
+    struct Topic {
+        std::string m_Name;
+        Segments m_Segments;
+        bool m_Stale{true};                     // m_Route must be compiled again
+        std::vector<OnValueChanged*> m_Route;
+    };
+
+    // The topics, by their segments.
+    struct TopicNode {
+        std::unordered_map<uint32_t, std::unique_ptr<TopicNode>> m_Children;
+        std::vector<TopicId> m_Topics;          // topics which end at this node
+    };
+
+    // '+' in Subscription::m_Pattern. Never returned by Intern().
+    static constexpr uint32_t AnyOne = UINT32_MAX;
+
+    struct Subscription {
+        OnValueChanged *m_pObserver{};          // null for a free slot
+        Node *m_pNode{};
+        bool m_AllBelow{};
+        Segments m_Pattern;                     // without the '#'
+    };
+
+    std::unordered_map<std::string, uint32_t> m_SegmentIds;
+    std::vector<Topic> m_Topics;
+    TopicNode m_TopicRoot;
+    Node m_Root;
+    std::vector<Subscription> m_Subscriptions;
+    std::vector<SubscriptionId> m_FreeSubscriptions;
+
+    uint32_t Intern(const std::string &segment) {
+        auto it = m_SegmentIds.find(segment);
+        if (it != m_SegmentIds.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(m_SegmentIds.size());
+        m_SegmentIds.emplace(segment, id);
+        return id;
+    }
+
+    static std::vector<std::string> Split(const std::string &path) {
+        std::vector<std::string> segments;
+        size_t start = 0;
+        while (true) {
+            size_t slash = path.find('/', start);
+            segments.push_back(path.substr(start, slash - start));
+            if (slash == std::string::npos) {
+                return segments;
+            }
+            start = slash + 1;
+        }
+    }
+
+    static void Match(const Node &node, const uint32_t *pSegment, size_t count, SubscriberSet &matches) {
+        matches |= node.m_AllBelow;
+        if (count == 0) {
+            matches |= node.m_Here;
+            return;
+        }
+        auto it = node.m_Children.find(*pSegment);
+        if (it != node.m_Children.end()) {
+            Match(*it->second, pSegment + 1, count - 1, matches);
+        }
+        if (node.m_AnyOne) {
+            Match(*node.m_AnyOne, pSegment + 1, count - 1, matches);
+        }
+    }
+
+    void Compile(Topic &topic) {
+        SubscriberSet matches;
+        Match(m_Root, topic.m_Segments.data(), topic.m_Segments.size(), matches);
+        topic.m_Route.clear();
+        matches.ForEach([this, &topic](size_t index) {
+            topic.m_Route.push_back(m_Subscriptions[index].m_pObserver);
+        });
+        topic.m_Stale = false;
+    }
+
+    void InvalidateAll(const TopicNode &node) {
+        for (auto id : node.m_Topics) {
+            m_Topics[id].m_Stale = true;
+        }
+        for (auto &child : node.m_Children) {
+            InvalidateAll(*child.second);
+        }
+    }
+
+    // Marks the routes of the topics which match the pattern.
+    void Invalidate(const TopicNode &node, const uint32_t *pSegment, size_t count, bool allBelow) {
+        if (count == 0) {
+            if (allBelow) {
+                InvalidateAll(node);
+                return;
+            }
+            for (auto id : node.m_Topics) {
+                m_Topics[id].m_Stale = true;
+            }
+            return;
+        }
+        if (*pSegment == AnyOne) {
+            for (auto &child : node.m_Children) {
+                Invalidate(*child.second, pSegment + 1, count - 1, allBelow);
+            }
+            return;
+        }
+        auto it = node.m_Children.find(*pSegment);
+        if (it != node.m_Children.end()) {
+            Invalidate(*it->second, pSegment + 1, count - 1, allBelow);
+        }
+    }
+
+    void Invalidate(const Subscription &subscription) {
+        Invalidate(m_TopicRoot, subscription.m_Pattern.data(), subscription.m_Pattern.size(), subscription.m_AllBelow);
+    }
+public:
+    // Called once by every sensor.
+    TopicId AddTopic(const std::string &name) {
+        Topic topic;
+        topic.m_Name = name;
+        TopicNode *pNode = &m_TopicRoot;
+        for (auto &segment : Split(name)) {
+            uint32_t id = Intern(segment);
+            topic.m_Segments.push_back(id);
+            auto &pChild = pNode->m_Children[id];
+            if (!pChild) {
+                pChild.reset(new TopicNode);
+            }
+            pNode = pChild.get();
+        }
+        auto id = static_cast<TopicId>(m_Topics.size());
+        pNode->m_Topics.push_back(id);
+        m_Topics.push_back(std::move(topic));
+        return id;
+    }
+
+    const std::string& TopicName(TopicId topic) const {
+        return m_Topics[topic].m_Name;
+    }
+
+    // Returns the id to unsubscribe with.
+    SubscriptionId Subscribe(const std::string &pattern, OnValueChanged *pValueChanged) {
+        auto segments = Split(pattern);
+        Node *pNode = &m_Root;
+        bool allBelow = false;
+        Segments ids;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            auto &segment = segments[i];
+            if (segment == "#") {
+                if (i + 1 != segments.size()) {
+                    std::cout << "[ChangeManager] '#' must be the last segment of " << pattern << "\n";
+                }
+                allBelow = true;
+                break;
+            }
+            ids.push_back(segment == "+" ? AnyOne : Intern(segment));
+            auto &pChild = segment == "+" ? pNode->m_AnyOne : pNode->m_Children[ids.back()];
+            if (!pChild) {
+                pChild.reset(new Node);
+            }
+            pNode = pChild.get();
+        }
+
+        SubscriptionId id;
+        if (!m_FreeSubscriptions.empty()) {
+            id = m_FreeSubscriptions.back();
+            m_FreeSubscriptions.pop_back();
+        }
+        else {
+            id = static_cast<SubscriptionId>(m_Subscriptions.size());
+            m_Subscriptions.emplace_back();
+        }
+        m_Subscriptions[id] = {pValueChanged, pNode, allBelow, std::move(ids)};
+        (allBelow ? pNode->m_AllBelow : pNode->m_Here).Set(id);
+        Invalidate(m_Subscriptions[id]);
+        return id;
+    }
+
+    // The trie nodes are kept, a later subscription to the same pattern reuses them.
+    void Unsubscribe(SubscriptionId id) {
+        if (id >= m_Subscriptions.size() || !m_Subscriptions[id].m_pObserver) {
+            return;
+        }
+        auto &subscription = m_Subscriptions[id];
+        (subscription.m_AllBelow ? subscription.m_pNode->m_AllBelow : subscription.m_pNode->m_Here).Reset(id);
+        Invalidate(subscription);
+        subscription = {};
+        m_FreeSubscriptions.push_back(id);
+    }
+
+    void Notify(Sensor *pSensor) {
+        auto &topic = m_Topics[pSensor->GetTopic()];
+        if (topic.m_Stale) {
+            Compile(topic);
+        }
+        for (auto ob : topic.m_Route) {
+            ob->Notify(pSensor);
+        }
+    }
+};
+
+
+
+
+
+//////////////////////////////////////////////
+////////////////////////  TemperatureSensor.h
+//////////////////////////////////////////////
+class TemperatureSensor : public Sensor {
+    float m_Temp{};
+    ChangeManager *m_pMgr;
+    TopicId m_Topic;
+public:
+    // e.g. topic "zone4/temperature/17"
+    TemperatureSensor(ChangeManager *pMgr, const std::string &topic) : m_pMgr{pMgr}, m_Topic{pMgr->AddTopic(topic)} {}
+
+    void Notify() override {
+        m_pMgr->Notify(this);
+    }
+
+    void SetTemp(float value) {
+        m_Temp = value;
+        Notify();
+    }
+
+    float GetValue() const override {
+        return m_Temp;
+    }
+
+    TopicId GetTopic() const override {
+        return m_Topic;
+    }
+};
+
+
+
+//////////////////////////////////////////////
+////////////////////////  WindSpeedSensor.h
+//////////////////////////////////////////////
+class WindSpeedSensor : public Sensor {
+    float m_Speed{};
+    ChangeManager *m_pMgr;
+    TopicId m_Topic;
+public:
+    WindSpeedSensor(ChangeManager *pMgr, const std::string &topic) : m_pMgr{pMgr}, m_Topic{pMgr->AddTopic(topic)} {}
+
+    void Notify() override {
+        m_pMgr->Notify(this);
+    }
+
+    // to simulate the change in wind speed.
+    void SetSpeed(float value) {
+        m_Speed = value;
+        Notify();
+    }
+
+    float GetValue() const override {
+        return m_Speed;
+    }
+
+    TopicId GetTopic() const override {
+        return m_Topic;
+    }
+};
+
+
+
+
+///////////////////////////////////////
+////////////////////////   Billboard.h
+///////////////////////////////////////
+#include <iostream>
+// Counts the readings, there are too many to print.
+class Billboard : public OnValueChanged {
+    size_t m_Readings{};
+public:
+    void Notify(Sensor *) override {
+        ++m_Readings;
+    }
+    size_t Readings() const { return m_Readings; }
+};
+
+
+
+///////////////////////////////////////
+////////////////////////   Recorder.h
+///////////////////////////////////////
+#include <iostream>
+class Recorder : public OnValueChanged {
+    size_t m_Readings{};
+public:
+    void Notify(Sensor *) override {
+        ++m_Readings;
+    }
+    size_t Readings() const { return m_Readings; }
+};
+
+
+///////////////////////////////////////////
+////////////////////////   SimpleDisplay.h
+///////////////////////////////////////////
+#include <iostream>
+class SimpleDisplay : public OnValueChanged {
+    const ChangeManager *m_pMgr;
+public:
+    explicit SimpleDisplay(const ChangeManager *pMgr) : m_pMgr{pMgr} {}
+
+    void Notify(Sensor *pSensor) override {
+        std::cout << "[SIMPLEDISPLAY] " << m_pMgr->TopicName(pSensor->GetTopic()) << " : " << pSensor->GetValue() << "\n";
+    }
+};
+
+
+
+
+
+#include <chrono>
+
+int main() {
+    // 20 zones, with 1000 temperature and 1000 wind sensors each.
+    constexpr int Zones = 20;
+    constexpr int SensorsPerKind = 1000;
+    ChangeManager mgr;
+    std::vector<TemperatureSensor> temperatureSensors;
+    std::vector<WindSpeedSensor> windSensors;
+    for (int zone = 0; zone < Zones; ++zone) {
+        for (int i = 0; i < SensorsPerKind; ++i) {
+            auto suffix = "zone" + std::to_string(zone);
+            temperatureSensors.emplace_back(&mgr, suffix + "/temperature/" + std::to_string(i));
+            windSensors.emplace_back(&mgr, suffix + "/wind/" + std::to_string(i));
+        }
+    }
+
+    Billboard bb;
+    Recorder rec;
+    Recorder allTemperatures;
+    SimpleDisplay sd{&mgr};
+
+    auto bbId = mgr.Subscribe("zone4/wind/+", &bb);
+    mgr.Subscribe("zone4/#", &rec);
+    mgr.Subscribe("+/temperature/+", &allTemperatures);
+    mgr.Subscribe("zone7/temperature/42", &sd);
+
+    // Every sensor publishes 10 readings.
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 10; ++round) {
+        for (auto &sensor : temperatureSensors) {
+            sensor.SetTemp(20.0f + round);
+        }
+        for (auto &sensor : windSensors) {
+            sensor.SetSpeed(10.0f * round);
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t readings = 10 * (temperatureSensors.size() + windSensors.size());
+    std::cout << readings << " readings in " << ms << " ms (" << ms * 1e6 / readings << " ns per reading)\n"
+              << "  zone4/wind/+    : " << bb.Readings() << "\n"
+              << "  zone4/#         : " << rec.Readings() << "\n"
+              << "  +/temperature/+ : " << allTemperatures.Readings() << "\n";
+
+    std::cout << "Unsubscribing the billboard...\n";
+    mgr.Unsubscribe(bbId);
+    windSensors[4 * SensorsPerKind].SetSpeed(99.0f);
+    std::cout << "  zone4/wind/+    : " << bb.Readings() << "\n"
+              << "  zone4/#         : " << rec.Readings() << "\n";
+
+    // An observer subscribes to one sensor and unsubscribes again, every round.
+    // Only the route of that sensor is compiled again, not the 40000 others.
+    Recorder oneSensor;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 10; ++round) {
+        auto id = mgr.Subscribe("zone7/wind/42", &oneSensor);
+        for (auto &sensor : temperatureSensors) {
+            sensor.SetTemp(20.0f + round);
+        }
+        for (auto &sensor : windSensors) {
+            sensor.SetSpeed(10.0f * round);
+        }
+        mgr.Unsubscribe(id);
+    }
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "With a subscription per round : " << ms * 1e6 / readings << " ns per reading\n"
+              << "  zone7/wind/42   : " << oneSensor.Readings() << "\n";
+
+    return 0;
+}
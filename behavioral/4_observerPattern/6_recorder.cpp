@@ -0,0 +1,612 @@
+/*
+    Recorder with a time series store.
+
+    In 5_change_manager.cpp the Recorder prints the readings and forgets them. A recorder has to
+    keep them, and a sensor read a thousand times per second sends 3.6 million readings per hour.
+    Kept as they come (an 8 byte time and a 4 byte float) that is 43 MB per sensor and hour.
+
+    TimeSeriesStore keeps the readings of every sensor in a Series of compressed blocks, as in
+    Facebook's Gorilla paper :
+     - Times (microseconds) : the readings come at an almost regular rate, so the difference
+       between two consecutive deltas ("delta of delta") is mostly 0 or tiny.
+       0 is stored as 1 bit, small values as 2-4 bits of prefix and 7, 9 or 12 bits, others in 36 bits.
+     - Values : a float is XORed with the previous one. Equal values give 0 (1 bit). Close values
+       share the sign, the exponent and the high bits of the mantissa, so the XOR has many leading
+       and trailing zeros, only the bits in between are stored.
+     - A Block has a fixed size (4 KB). It also keeps its first and last time and the count, min, max
+       and sum of its values.
+     - Bounded memory : a Series keeps at most maxBlocks blocks. When it is full the oldest block is
+       dropped and reused for the new readings, so no memory is allocated after that.
+     - Scan(from, to) finds the first block with a binary search on the times of the blocks
+       and decodes only the blocks in the range.
+     - Downsample(from, to, width) returns count / min / max / average per bucket of width.
+       A block which lies in one bucket is added from its summary, without decoding it.
+
+    Readings must come in order of time for each sensor. Older ones are rejected and counted.
+
+
+            ---------------------                          ---------------------
+            |   ChangeManager   |------------------------->|     Recorder      |
+            ---------------------        Notify()          ---------------------
+                                                                     |
+                                                          ---------------------
+                                                          |  TimeSeriesStore  |  Sensor* -> Series
+                                                          ---------------------
+                                                                     |
+                                                          ---------------------
+                                                          |      Series       |  Block Block Block ...
+                                                          ---------------------
+*/
+
+// Subject
+/////////////////////////////////////////////
+/////////////////////        Sensor.h
+/////////////////////////////////////////////
+class Sensor {
+public:
+    virtual float GetValue() const = 0;
+    virtual void Notify() = 0;
+    virtual ~Sensor() = default;
+};
+
+// Observer
+///////////////////////////////////////////
+////////////////////////  OnValuechanged.h
+///////////////////////////////////////////
+class OnValueChanged {
+public:
+    //  Using pSensor the Observers can know with Subject sent them the notification.
+    virtual void Notify(Sensor *pSensor) = 0;
+    virtual ~OnValueChanged() = default;
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        ChangeManager.h
+/////////////////////////////////////////////
+#include <unordered_map>
+#include <list>
+class ChangeManager {
+    // A mapping between the subjects and their observers.
+    std::unordered_map<Sensor *, std::list<OnValueChanged*>> m_Mapping;
+public:
+    void Register(Sensor *pSensor, OnValueChanged *pValueChanged) {
+        m_Mapping[pSensor].push_back(pValueChanged);
+    }
+
+    void DeRegister(Sensor *pSensor, OnValueChanged *pValueChanged) {
+        auto it = m_Mapping.find(pSensor);
+        if (it != m_Mapping.end()) {
+            it->second.remove(pValueChanged);
+        }
+    }
+
+    void Notify(Sensor *pSensor) {
+        auto it = m_Mapping.find(pSensor);
+        if (it == m_Mapping.end()) {
+            return;
+        }
+        for (auto ob : it->second) {
+            ob->Notify(pSensor);
+        }
+    }
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        Block.h
+/////////////////////////////////////////////
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Compressed readings : the first one in the header, the others in m_Bits.
+class Block {
+public:
+    static constexpr size_t Words = 496;        // 4 KB with the header
+private:
+    // The most bits Append() can write : 36 for the time, 44 for the value.
+    static constexpr size_t MaxBitsPerReading = 80;
+
+    int64_t m_FirstTime{};
+    int64_t m_LastTime{};
+    int64_t m_LastDelta{};
+    uint32_t m_FirstBits{};
+    uint32_t m_LastBits{};
+    uint32_t m_Count{};
+    uint8_t m_Leading{};                        // the window of meaningful bits of the last XOR
+    uint8_t m_Trailing{};
+    bool m_HasWindow{};
+    float m_Min{};
+    float m_Max{};
+    double m_Sum{};
+    size_t m_BitCount{};
+    uint64_t m_Bits[Words];
+
+    static uint32_t ToBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static float ToFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // The bits are stored from the least significant bit of each word.
+    void Write(uint64_t value, unsigned count) {
+        if (count < 64) {
+            value &= (uint64_t{1} << count) - 1;
+        }
+        size_t word = m_BitCount / 64;
+        unsigned offset = m_BitCount % 64;
+        m_Bits[word] |= value << offset;
+        if (offset + count > 64) {
+            m_Bits[word + 1] |= value >> (64 - offset);
+        }
+        m_BitCount += count;
+    }
+
+    class Reader {
+        const uint64_t *m_pBits;
+        size_t m_Position{};
+    public:
+        explicit Reader(const uint64_t *pBits) : m_pBits{pBits} {}
+
+        uint64_t Read(unsigned count) {
+            size_t word = m_Position / 64;
+            unsigned offset = m_Position % 64;
+            uint64_t value = m_pBits[word] >> offset;
+            if (offset + count > 64) {
+                value |= m_pBits[word + 1] << (64 - offset);
+            }
+            if (count < 64) {
+                value &= (uint64_t{1} << count) - 1;
+            }
+            m_Position += count;
+            return value;
+        }
+    };
+
+    struct TimeClass {
+        unsigned m_Bits;
+        int64_t m_Bias;         // added to store the delta of delta as unsigned
+    };
+    // Selected by the number of 1 bits of the prefix : 10, 110, 1110, 1111.
+    static constexpr TimeClass TimeClasses[4] = {{7, 63}, {9, 255}, {12, 2047}, {32, 2147483647}};
+
+    void WriteTime(int64_t deltaOfDelta) {
+        if (deltaOfDelta == 0) {
+            Write(0, 1);
+            return;
+        }
+        for (unsigned ones = 1; ones <= 4; ++ones) {
+            auto &timeClass = TimeClasses[ones - 1];
+            int64_t stored = deltaOfDelta + timeClass.m_Bias;
+            if (stored >= 0 && stored < (int64_t{1} << timeClass.m_Bits)) {
+                Write((uint64_t{1} << ones) - 1, ones);
+                if (ones < 4) {
+                    Write(0, 1);
+                }
+                Write(static_cast<uint64_t>(stored), timeClass.m_Bits);
+                return;
+            }
+        }
+    }
+
+    static int64_t ReadTime(Reader &reader) {
+        unsigned ones = 0;
+        while (ones < 4 && reader.Read(1)) {
+            ++ones;
+        }
+        if (ones == 0) {
+            return 0;
+        }
+        auto &timeClass = TimeClasses[ones - 1];
+        return static_cast<int64_t>(reader.Read(timeClass.m_Bits)) - timeClass.m_Bias;
+    }
+
+    void WriteValue(uint32_t bits) {
+        uint32_t x = bits ^ m_LastBits;
+        if (x == 0) {
+            Write(0, 1);
+            return;
+        }
+        Write(1, 1);
+        unsigned leading = __builtin_clz(x);
+        unsigned trailing = __builtin_ctz(x);
+        if (m_HasWindow && leading >= m_Leading && trailing >= m_Trailing) {
+            // Fits in the window of the previous value.
+            Write(0, 1);
+            Write(x >> m_Trailing, 32 - m_Leading - m_Trailing);
+            return;
+        }
+        unsigned meaningful = 32 - leading - trailing;
+        Write(1, 1);
+        Write(leading, 5);
+        Write(meaningful - 1, 5);
+        Write(x >> trailing, meaningful);
+        m_Leading = static_cast<uint8_t>(leading);
+        m_Trailing = static_cast<uint8_t>(trailing);
+        m_HasWindow = true;
+    }
+public:
+    // Starts the block again with a first reading.
+    void Reset(int64_t time, float value) {
+        m_FirstTime = m_LastTime = time;
+        m_LastDelta = 0;
+        m_FirstBits = m_LastBits = ToBits(value);
+        m_Count = 1;
+        m_HasWindow = false;
+        m_Min = m_Max = value;
+        m_Sum = value;
+        m_BitCount = 0;
+        std::memset(m_Bits, 0, sizeof(m_Bits));
+    }
+
+    // Returns false if the block is full, or if the reading is too far from the previous one.
+    bool Append(int64_t time, float value) {
+        int64_t delta = time - m_LastTime;
+        int64_t deltaOfDelta = delta - m_LastDelta;
+        if (m_BitCount + MaxBitsPerReading > Words * 64
+            || deltaOfDelta < -TimeClasses[3].m_Bias || deltaOfDelta > TimeClasses[3].m_Bias + 1) {
+            return false;
+        }
+        WriteTime(deltaOfDelta);
+        uint32_t bits = ToBits(value);
+        WriteValue(bits);
+        m_LastTime = time;
+        m_LastDelta = delta;
+        m_LastBits = bits;
+        ++m_Count;
+        m_Min = std::min(m_Min, value);
+        m_Max = std::max(m_Max, value);
+        m_Sum += value;
+        return true;
+    }
+
+    // Calls fn(time, value) for every reading, in order. Stops when fn returns false.
+    template <typename Fn>
+    void Decode(Fn fn) const {
+        if (m_Count == 0 || !fn(m_FirstTime, ToFloat(m_FirstBits))) {
+            return;
+        }
+        Reader reader{m_Bits};
+        int64_t time = m_FirstTime;
+        int64_t delta = 0;
+        uint32_t bits = m_FirstBits;
+        unsigned leading = 0;
+        unsigned trailing = 0;
+        for (uint32_t i = 1; i < m_Count; ++i) {
+            delta += ReadTime(reader);
+            time += delta;
+            if (reader.Read(1)) {
+                if (reader.Read(1)) {
+                    leading = static_cast<unsigned>(reader.Read(5));
+                    unsigned meaningful = static_cast<unsigned>(reader.Read(5)) + 1;
+                    trailing = 32 - leading - meaningful;
+                }
+                bits ^= static_cast<uint32_t>(reader.Read(32 - leading - trailing)) << trailing;
+            }
+            if (!fn(time, ToFloat(bits))) {
+                return;
+            }
+        }
+    }
+
+    int64_t FirstTime() const { return m_FirstTime; }
+    int64_t LastTime() const { return m_LastTime; }
+    uint32_t Count() const { return m_Count; }
+    float Min() const { return m_Min; }
+    float Max() const { return m_Max; }
+    double Sum() const { return m_Sum; }
+    size_t BitCount() const { return m_BitCount; }
+};
+
+constexpr Block::TimeClass Block::TimeClasses[4];
+
+
+/////////////////////////////////////////////
+/////////////////////        Series.h
+/////////////////////////////////////////////
+#include <deque>
+#include <memory>
+#include <vector>
+#include <limits>
+
+struct Bucket {
+    int64_t m_Start;
+    uint32_t m_Count{};
+    float m_Min{std::numeric_limits<float>::max()};
+    float m_Max{std::numeric_limits<float>::lowest()};
+    double m_Sum{};
+
+    double Average() const { return m_Count ? m_Sum / m_Count : 0.0; }
+};
+
+// The readings of one sensor, oldest block first.
+class Series {
+    std::deque<std::unique_ptr<Block>> m_Blocks;
+    size_t m_MaxBlocks;
+    size_t m_Rejected{};
+
+    // The first block which may have readings at or after time.
+    std::deque<std::unique_ptr<Block>>::const_iterator FirstBlock(int64_t time) const {
+        return std::partition_point(m_Blocks.begin(), m_Blocks.end(),
+                                    [time](const std::unique_ptr<Block> &pBlock) { return pBlock->LastTime() < time; });
+    }
+public:
+    explicit Series(size_t maxBlocks) : m_MaxBlocks{std::max<size_t>(maxBlocks, 1)} {}
+
+    void Append(int64_t time, float value) {
+        if (!m_Blocks.empty()) {
+            auto &last = *m_Blocks.back();
+            if (time < last.LastTime()) {
+                ++m_Rejected;
+                return;
+            }
+            if (last.Append(time, value)) {
+                return;
+            }
+        }
+        std::unique_ptr<Block> pBlock;
+        if (m_Blocks.size() == m_MaxBlocks) {
+            // Drops the oldest readings.
+            pBlock = std::move(m_Blocks.front());
+            m_Blocks.pop_front();
+        }
+        else {
+            pBlock.reset(new Block);
+        }
+        pBlock->Reset(time, value);
+        m_Blocks.push_back(std::move(pBlock));
+    }
+
+    // Calls fn(time, value) for every reading in [from, to).
+    template <typename Fn>
+    void Scan(int64_t from, int64_t to, Fn fn) const {
+        for (auto it = FirstBlock(from); it != m_Blocks.end() && (*it)->FirstTime() < to; ++it) {
+            (*it)->Decode([from, to, &fn](int64_t time, float value) {
+                if (time >= to) {
+                    return false;
+                }
+                if (time >= from) {
+                    fn(time, value);
+                }
+                return true;
+            });
+        }
+    }
+
+    // One bucket per width in [from, to). Empty buckets have a count of 0.
+    std::vector<Bucket> Downsample(int64_t from, int64_t to, int64_t width) const {
+        std::vector<Bucket> buckets;
+        if (width <= 0 || to <= from) {
+            return buckets;
+        }
+        for (int64_t start = from; start < to; start += width) {
+            buckets.push_back(Bucket{start});
+        }
+        auto add = [&buckets, from, width](int64_t time, float value) {
+            auto &bucket = buckets[static_cast<size_t>((time - from) / width)];
+            ++bucket.m_Count;
+            bucket.m_Min = std::min(bucket.m_Min, value);
+            bucket.m_Max = std::max(bucket.m_Max, value);
+            bucket.m_Sum += value;
+        };
+        for (auto it = FirstBlock(from); it != m_Blocks.end() && (*it)->FirstTime() < to; ++it) {
+            auto &block = **it;
+            if (block.FirstTime() >= from && block.LastTime() < to
+                && (block.FirstTime() - from) / width == (block.LastTime() - from) / width) {
+                auto &bucket = buckets[static_cast<size_t>((block.FirstTime() - from) / width)];
+                bucket.m_Count += block.Count();
+                bucket.m_Min = std::min(bucket.m_Min, block.Min());
+                bucket.m_Max = std::max(bucket.m_Max, block.Max());
+                bucket.m_Sum += block.Sum();
+                continue;
+            }
+            block.Decode([&add, from, to](int64_t time, float value) {
+                if (time >= to) {
+                    return false;
+                }
+                if (time >= from) {
+                    add(time, value);
+                }
+                return true;
+            });
+        }
+        return buckets;
+    }
+
+    size_t Count() const {
+        size_t count = 0;
+        for (auto &pBlock : m_Blocks) {
+            count += pBlock->Count();
+        }
+        return count;
+    }
+
+    size_t Bytes() const { return m_Blocks.size() * sizeof(Block); }
+    size_t Rejected() const { return m_Rejected; }
+    bool Empty() const { return m_Blocks.empty(); }
+    int64_t FirstTime() const { return m_Blocks.empty() ? 0 : m_Blocks.front()->FirstTime(); }
+    int64_t LastTime() const { return m_Blocks.empty() ? 0 : m_Blocks.back()->LastTime(); }
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        TimeSeriesStore.h
+/////////////////////////////////////////////
+class TimeSeriesStore {
+    std::unordered_map<const Sensor*, Series> m_Series;
+    size_t m_MaxBlocksPerSeries;
+public:
+    // Every series takes at most maxBlocksPerSeries * sizeof(Block) bytes.
+    explicit TimeSeriesStore(size_t maxBlocksPerSeries) : m_MaxBlocksPerSeries{maxBlocksPerSeries} {}
+
+    void Append(const Sensor *pSensor, int64_t time, float value) {
+        auto it = m_Series.find(pSensor);
+        if (it == m_Series.end()) {
+            it = m_Series.emplace(pSensor, Series{m_MaxBlocksPerSeries}).first;
+        }
+        it->second.Append(time, value);
+    }
+
+    // Null if the sensor has no readings.
+    const Series* Find(const Sensor *pSensor) const {
+        auto it = m_Series.find(pSensor);
+        return it == m_Series.end() ? nullptr : &it->second;
+    }
+};
+
+
+
+
+
+//////////////////////////////////////////////
+////////////////////////  TemperatureSensor.h
+//////////////////////////////////////////////
+class TemperatureSensor : public Sensor {
+    float m_Temp{};
+    ChangeManager *m_pMgr;
+public:
+    TemperatureSensor(ChangeManager *pMgr) : m_pMgr{pMgr} {}
+
+    void Notify() override {
+        m_pMgr->Notify(this);
+    }
+
+    void SetTemp(float value) {
+        m_Temp = value;
+        Notify();
+    }
+
+    float GetValue() const override {
+        return m_Temp;
+    }
+};
+
+
+
+//////////////////////////////////////////////
+////////////////////////  WindSpeedSensor.h
+//////////////////////////////////////////////
+class WindSpeedSensor : public Sensor {
+    float m_Speed{};
+    ChangeManager *m_pMgr;
+public:
+    WindSpeedSensor(ChangeManager *pMgr) : m_pMgr{pMgr} {}
+
+    void Notify() override {
+        m_pMgr->Notify(this);
+    }
+
+    // to simulate the change in wind speed.
+    void SetSpeed(float value) {
+        m_Speed = value;
+        Notify();
+    }
+
+    float GetValue() const override {
+        return m_Speed;
+    }
+};
+
+
+
+///////////////////////////////////////
+////////////////////////   Recorder.h
+///////////////////////////////////////
+#include <chrono>
+#include <functional>
+
+// Stores every reading with the time it was received.
+class Recorder : public OnValueChanged {
+    TimeSeriesStore *m_pStore;
+    std::function<int64_t()> m_Clock;
+public:
+    // clock returns the current time in microseconds.
+    Recorder(TimeSeriesStore *pStore, std::function<int64_t()> clock) : m_pStore{pStore}, m_Clock{std::move(clock)} {}
+
+    explicit Recorder(TimeSeriesStore *pStore)
+        : Recorder{pStore, []() {
+              using namespace std::chrono;
+              return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+          }} {}
+
+    void Notify(Sensor *pSensor) override {
+        m_pStore->Append(pSensor, m_Clock(), pSensor->GetValue());
+    }
+};
+
+
+
+
+
+#include <iostream>
+#include <cmath>
+
+int main() {
+    ChangeManager mgr;
+    TemperatureSensor sensor{&mgr};
+    WindSpeedSensor windSensor{&mgr};
+
+    // An hour of readings at 1 kHz is simulated, the recorder takes the simulated time.
+    int64_t now = 0;
+    // At most 128 blocks of 4 KB per sensor. The oldest readings of the hour are dropped.
+    TimeSeriesStore store{128};
+    Recorder rec{&store, [&now]() { return now; }};
+    mgr.Register(&sensor, &rec);
+    mgr.Register(&windSensor, &rec);
+
+    // The temperature is read with a precision of 0.01 and the wind speed of 0.1.
+    // The readings come every millisecond, a few microseconds late sometimes.
+    auto temperatureAt = [](int64_t ms) { return static_cast<float>(std::round((20.0 + 5.0 * std::sin(ms / 600000.0)) * 100.0) / 100.0); };
+    auto windAt = [](int64_t ms) { return static_cast<float>(std::round((30.0 + 10.0 * std::sin(ms / 7000.0) * std::cos(ms / 1300.0)) * 10.0) / 10.0); };
+    constexpr int64_t Readings = 3600 * 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t ms = 0; ms < Readings; ++ms) {
+        now = ms * 1000 + (ms % 97 == 0 ? 7 : 0);
+        sensor.SetTemp(temperatureAt(ms));
+        windSensor.SetSpeed(windAt(ms));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto &temperatures = *store.Find(&sensor);
+    auto &winds = *store.Find(&windSensor);
+    std::cout << "Recorded " << 2 * Readings << " readings in " << seconds * 1000 << " ms ("
+              << seconds * 1e9 / (2 * Readings) << " ns per reading)\n";
+    for (auto pSeries : {&temperatures, &winds}) {
+        std::cout << "  " << (pSeries == &temperatures ? "temperature" : "wind speed ")
+                  << " : keeps " << pSeries->Count() << " readings from " << pSeries->FirstTime() / 1000000.0
+                  << " s to " << pSeries->LastTime() / 1000000.0 << " s in " << pSeries->Bytes() / 1024 << " KB, "
+                  << pSeries->Bytes() * 8.0 / pSeries->Count() << " bits per reading\n";
+    }
+
+    // Checks the last minute against the readings sent.
+    int64_t from = (Readings - 60000) * 1000;
+    size_t scanned = 0;
+    size_t mismatches = 0;
+    now -= 1000;
+    windSensor.SetSpeed(0.0f);      // older than the last reading : rejected
+    winds.Scan(from, Readings * 1000, [&](int64_t time, float value) {
+        int64_t ms = time / 1000;
+        mismatches += time != ms * 1000 + (ms % 97 == 0 ? 7 : 0) || value != windAt(ms);
+        ++scanned;
+    });
+    std::cout << "Last minute of wind : " << scanned << " readings, " << mismatches << " mismatches, "
+              << winds.Rejected() << " rejected\n";
+
+    // Averages of the temperature per 5 minutes, over what is kept.
+    int64_t width = 300 * 1000000LL;
+    int64_t first = temperatures.FirstTime() / width * width;
+    std::cout << "Temperature per 5 minutes :\n";
+    for (auto &bucket : temperatures.Downsample(first, temperatures.LastTime() + 1, width)) {
+        std::cout << "  " << bucket.m_Start / 60000000 << " min : " << bucket.m_Count << " readings, min "
+                  << bucket.m_Min << ", max " << bucket.m_Max << ", average " << bucket.Average() << "\n";
+    }
+
+    return 0;
+}
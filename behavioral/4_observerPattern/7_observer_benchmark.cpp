@@ -0,0 +1,472 @@
+/*
+    Benchmark of the notification mechanisms of the examples.
+
+    The examples are included as they are, each in its own namespace, and driven by the same
+    benchmark observers :
+     - basic        : Subject / ConcreteSubject of 1_basic_observer.cpp. The observers pull the
+                      state (a string) with GetState(), so the payload size matters.
+     - manager      : the synchronous ChangeManager of 5_change_manager.cpp.
+     - manager/async: the asynchronous ChangeManager of 5_change_manager_2.cpp, 2 sensor threads,
+                      1 or 2 dispatcher threads. Readings which do not fit in the rings are dropped.
+     - sensor/...   : the TemperatureSensor of 4_sensor_3.cpp with a delivery policy.
+     - person/mutex : Person of observer3.cpp (a global mutex held during notify())
+       person/cow   : Person of observer4.cpp (copy-on-write snapshot)
+                      every thread changes its own Person, the listeners are shared.
+
+    For each run it prints :
+     - notif/s      : notifications delivered per second, for all the observers together.
+     - latency      : the time from the publication (SetState(), SetTemp(), SetAge()) to the
+                      delivery to the last observer, which is notified last. It includes the whole
+                      fan-out, and the queueing in the asynchronous mode. Every 16th publication is
+                      measured, the percentiles come from a histogram with 8 buckets per power of 2.
+
+    Each value published carries the number of its publisher and a sequence number, so the
+    observers can find when it was published. The clock reads are part of the measured cost.
+
+    Run it with optimizations for meaningful numbers : g++ -O2 -std=c++14 -pthread
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/any.hpp>
+
+// The standard headers are included above, so the includes of the examples add nothing
+// to their namespaces.
+#define main basic_main
+namespace basic {
+#include "1_basic_observer.cpp"
+}
+#undef main
+#define main manager_main
+namespace manager {
+#include "5_change_manager.cpp"
+}
+#undef main
+#define main async_manager_main
+namespace async_manager {
+#include "5_change_manager_2.cpp"
+}
+#undef main
+#define main sensor_main
+namespace sensor {
+#include "4_sensor_3.cpp"
+}
+#undef main
+#define main person_mutex_main
+namespace person_mutex {
+#include "observer3.cpp"
+}
+#undef main
+#define main person_cow_main
+namespace person_cow {
+#include "observer4.cpp"
+}
+#undef main
+
+
+/////////////////////////////////////////////
+/////////////////////        Histogram.h
+/////////////////////////////////////////////
+// Nanoseconds, 8 buckets per power of 2 (12% precision).
+class Histogram {
+    static constexpr size_t SubBuckets = 8;
+    static constexpr size_t Buckets = 16 + (64 - 4) * SubBuckets;
+    uint64_t m_Counts[Buckets]{};
+    uint64_t m_Total{};
+    uint64_t m_Max{};
+
+    static size_t IndexOf(uint64_t value) {
+        if (value < 16) {
+            return static_cast<size_t>(value);
+        }
+        unsigned exponent = 63 - __builtin_clzll(value);
+        size_t sub = static_cast<size_t>(value >> (exponent - 3)) & (SubBuckets - 1);
+        return 16 + (exponent - 4) * SubBuckets + sub;
+    }
+
+    static uint64_t LowerBound(size_t index) {
+        if (index < 16) {
+            return index;
+        }
+        unsigned exponent = static_cast<unsigned>((index - 16) / SubBuckets) + 4;
+        uint64_t sub = (index - 16) % SubBuckets;
+        return (uint64_t{1} << exponent) | (sub << (exponent - 3));
+    }
+public:
+    void Record(int64_t value) {
+        uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+        ++m_Counts[IndexOf(v)];
+        ++m_Total;
+        m_Max = std::max(m_Max, v);
+    }
+
+    void Merge(const Histogram &other) {
+        for (size_t i = 0; i < Buckets; ++i) {
+            m_Counts[i] += other.m_Counts[i];
+        }
+        m_Total += other.m_Total;
+        m_Max = std::max(m_Max, other.m_Max);
+    }
+
+    // fraction in [0, 1]
+    uint64_t Percentile(double fraction) const {
+        if (m_Total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * m_Total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; ++i) {
+            seen += m_Counts[i];
+            if (seen >= rank && seen > 0) {
+                return std::min(LowerBound(i), m_Max);
+            }
+        }
+        return m_Max;
+    }
+
+    uint64_t Max() const { return m_Max; }
+    uint64_t Total() const { return m_Total; }
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        Probe.h
+/////////////////////////////////////////////
+// The publication times and the deliveries of a run.
+namespace probe {
+    constexpr uint32_t SampleEvery = 16;
+    constexpr uint32_t SequenceBits = 20;       // a code fits exactly in a float
+    constexpr size_t MaxPublishers = 8;
+    constexpr size_t StampSlots = 4096;
+    constexpr size_t MaxThreads = 64;
+
+    int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<int64_t> stamps[MaxPublishers][StampSlots];
+
+    // One per thread which delivers notifications, merged at the end of the run.
+    struct Slot {
+        uint64_t m_Deliveries{};
+        Histogram m_Latency;
+    };
+    Slot slots[MaxThreads];
+    std::atomic<size_t> nextSlot{0};
+    std::atomic<unsigned> run{0};
+
+    Slot& ThreadSlot() {
+        thread_local unsigned t_Run = ~0u;
+        thread_local Slot *t_pSlot = nullptr;
+        if (t_Run != run.load(std::memory_order_relaxed)) {
+            t_Run = run.load(std::memory_order_relaxed);
+            t_pSlot = &slots[nextSlot.fetch_add(1) % MaxThreads];
+        }
+        return *t_pSlot;
+    }
+
+    // Called between runs, when no other thread is running.
+    void Reset() {
+        for (auto &slot : slots) {
+            slot = Slot{};
+        }
+        nextSlot = 0;
+        ++run;
+    }
+
+    // Returns the code to publish for the sequence number seq of publisher.
+    uint32_t Publish(uint32_t publisher, uint32_t seq) {
+        seq &= (1u << SequenceBits) - 1;
+        if (seq % SampleEvery == 0) {
+            stamps[publisher][seq / SampleEvery % StampSlots].store(Now(), std::memory_order_relaxed);
+        }
+        return publisher << SequenceBits | seq;
+    }
+
+    // measure : the observer is the last one notified.
+    void Deliver(uint32_t code, bool measure) {
+        auto &slot = ThreadSlot();
+        ++slot.m_Deliveries;
+        uint32_t seq = code & ((1u << SequenceBits) - 1);
+        if (measure && seq % SampleEvery == 0) {
+            uint32_t publisher = code >> SequenceBits;
+            slot.m_Latency.Record(Now() - stamps[publisher][seq / SampleEvery % StampSlots].load(std::memory_order_relaxed));
+        }
+    }
+
+    struct Result {
+        uint64_t m_Deliveries{};
+        Histogram m_Latency;
+    };
+
+    Result Collect() {
+        Result result;
+        for (auto &slot : slots) {
+            result.m_Deliveries += slot.m_Deliveries;
+            result.m_Latency.Merge(slot.m_Latency);
+        }
+        return result;
+    }
+}
+
+
+/////////////////////////////////////////////
+/////////////////////        Observers.h
+/////////////////////////////////////////////
+// The same observer for each interface.
+class BasicObserver : public basic::Observer {
+    basic::ConcreteSubject *m_pSubject;
+    bool m_Last;
+public:
+    BasicObserver(basic::ConcreteSubject *pSubject, bool last) : m_pSubject{pSubject}, m_Last{last} {}
+
+    void Update() override {
+        auto state = m_pSubject->GetState();
+        uint32_t code;
+        std::memcpy(&code, state.data(), sizeof(code));
+        probe::Deliver(code, m_Last);
+    }
+};
+
+class ManagerObserver : public manager::OnValueChanged {
+    bool m_Last;
+public:
+    explicit ManagerObserver(bool last) : m_Last{last} {}
+
+    void Notify(manager::Sensor *pSensor) override {
+        probe::Deliver(static_cast<uint32_t>(pSensor->GetValue()), m_Last);
+    }
+};
+
+class AsyncManagerObserver : public async_manager::OnValueChanged {
+    bool m_Last;
+public:
+    explicit AsyncManagerObserver(bool last) : m_Last{last} {}
+
+    void Notify(async_manager::Sensor *, float value) override {
+        probe::Deliver(static_cast<uint32_t>(value), m_Last);
+    }
+};
+
+class SensorObserver : public sensor::OnValuechanged {
+    bool m_Last;
+public:
+    explicit SensorObserver(bool last) : m_Last{last} {}
+
+    void Notify(float value) override {
+        probe::Deliver(static_cast<uint32_t>(value), m_Last);
+    }
+};
+
+template <typename PersonT, typename ListenerT>
+class PersonObserver : public ListenerT {
+    bool m_Last;
+public:
+    explicit PersonObserver(bool last) : m_Last{last} {}
+
+    void PersonChanged(PersonT &, const std::string &, const boost::any new_value) override {
+        probe::Deliver(static_cast<uint32_t>(boost::any_cast<int>(new_value)), m_Last);
+    }
+};
+
+
+/////////////////////////////////////////////
+/////////////////////        Benchmarks.h
+/////////////////////////////////////////////
+// Enough publications for about a million deliveries per run.
+constexpr size_t Deliveries = 1000000;
+
+struct Run {
+    std::string m_Mode;
+    size_t m_Observers;
+    std::string m_Payload;
+    size_t m_Threads;
+};
+
+void Report(const Run &run, double seconds, const std::string &note = "") {
+    auto result = probe::Collect();
+    auto &latency = result.m_Latency;
+    std::cout << std::left << std::setw(16) << run.m_Mode << std::right
+              << std::setw(6) << run.m_Observers << std::setw(9) << run.m_Payload << std::setw(5) << run.m_Threads
+              << std::setw(13) << static_cast<uint64_t>(result.m_Deliveries / seconds)
+              << std::setw(10) << latency.Percentile(0.5) << std::setw(10) << latency.Percentile(0.99)
+              << std::setw(10) << latency.Percentile(0.999) << std::setw(11) << latency.Max();
+    if (!note.empty()) {
+        std::cout << "  " << note;
+    }
+    std::cout << "\n";
+}
+
+template <typename Fn>
+double Time(Fn fn) {
+    probe::Reset();
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchBasic(size_t observerCount, size_t payload) {
+    basic::ConcreteSubject subject;
+    std::vector<std::unique_ptr<BasicObserver>> observers;
+    for (size_t i = 0; i < observerCount; ++i) {
+        observers.emplace_back(new BasicObserver{&subject, i + 1 == observerCount});
+        subject.Attach(*observers.back());
+    }
+    std::string state(payload, 'x');
+    size_t publications = Deliveries / observerCount;
+    double seconds = Time([&]() {
+        for (uint32_t seq = 0; seq < publications; ++seq) {
+            uint32_t code = probe::Publish(0, seq);
+            std::memcpy(&state[0], &code, sizeof(code));
+            subject.SetState(state);
+        }
+    });
+    Report({"basic", observerCount, std::to_string(payload) + "B", 1}, seconds);
+}
+
+void BenchManager(size_t observerCount) {
+    manager::ChangeManager mgr;
+    manager::TemperatureSensor temperature{&mgr};
+    std::vector<std::unique_ptr<ManagerObserver>> observers;
+    for (size_t i = 0; i < observerCount; ++i) {
+        observers.emplace_back(new ManagerObserver{i + 1 == observerCount});
+        mgr.Register(&temperature, observers.back().get());
+    }
+    size_t publications = Deliveries / observerCount;
+    double seconds = Time([&]() {
+        for (uint32_t seq = 0; seq < publications; ++seq) {
+            temperature.SetTemp(static_cast<float>(probe::Publish(0, seq)));
+        }
+    });
+    Report({"manager", observerCount, "float", 1}, seconds);
+}
+
+void BenchAsyncManager(size_t observerCount, size_t dispatchers) {
+    size_t dropped = 0;
+    size_t publications = Deliveries / observerCount / 2;
+    double seconds = Time([&]() {
+        async_manager::ChangeManager mgr{dispatchers};
+        async_manager::TemperatureSensor temperature{&mgr};
+        async_manager::WindSpeedSensor wind{&mgr};
+        std::vector<std::unique_ptr<AsyncManagerObserver>> observers;
+        for (size_t i = 0; i < observerCount; ++i) {
+            observers.emplace_back(new AsyncManagerObserver{i + 1 == observerCount});
+            mgr.Register(&temperature, observers.back().get());
+            mgr.Register(&wind, observers.back().get());
+        }
+        std::thread t1{[&]() {
+            for (uint32_t seq = 0; seq < publications; ++seq) {
+                temperature.SetTemp(static_cast<float>(probe::Publish(0, seq)));
+            }
+        }};
+        std::thread t2{[&]() {
+            for (uint32_t seq = 0; seq < publications; ++seq) {
+                wind.SetSpeed(static_cast<float>(probe::Publish(1, seq)));
+            }
+        }};
+        t1.join();
+        t2.join();
+        mgr.Flush();
+        dropped = temperature.GetChannel()->m_Dropped + wind.GetChannel()->m_Dropped;
+    });
+    Report({"manager/async", observerCount, "float", 2 + dispatchers}, seconds,
+           std::to_string(dropped * 100 / (2 * publications)) + "% dropped");
+}
+
+void BenchSensor(size_t observerCount, const std::string &name, sensor::DeliveryPolicy policy) {
+    sensor::TemperatureSensor temperature;
+    std::vector<std::unique_ptr<SensorObserver>> observers;
+    for (size_t i = 0; i < observerCount; ++i) {
+        observers.emplace_back(new SensorObserver{i + 1 == observerCount});
+        temperature.Register(observers.back().get(), policy);
+    }
+    size_t publications = Deliveries / observerCount;
+    double seconds = Time([&]() {
+        for (uint32_t seq = 0; seq < publications; ++seq) {
+            temperature.SetTemp(static_cast<float>(probe::Publish(0, seq)));
+        }
+        temperature.Flush(sensor::TemperatureSensor::Clock::now(), true);
+    });
+    Report({"sensor/" + name, observerCount, "float", 1}, seconds);
+}
+
+template <typename PersonT, typename ListenerT>
+void BenchPerson(const std::string &name, size_t observerCount, size_t threads) {
+    std::vector<std::unique_ptr<PersonObserver<PersonT, ListenerT>>> observers;
+    for (size_t i = 0; i < observerCount; ++i) {
+        observers.emplace_back(new PersonObserver<PersonT, ListenerT>{i + 1 == observerCount});
+    }
+    size_t publications = Deliveries / observerCount / threads;
+    double seconds = Time([&]() {
+        std::vector<std::thread> publishers;
+        for (uint32_t t = 0; t < threads; ++t) {
+            publishers.emplace_back([&, t]() {
+                PersonT person{-1};
+                for (auto &pObserver : observers) {
+                    person.subscribe(pObserver.get());
+                }
+                for (uint32_t seq = 0; seq < publications; ++seq) {
+                    person.SetAge(static_cast<int>(probe::Publish(t, seq)));
+                }
+            });
+        }
+        for (auto &publisher : publishers) {
+            publisher.join();
+        }
+    });
+    Report({name, observerCount, "int", threads}, seconds);
+}
+
+
+int main() {
+    std::cout << std::left << std::setw(16) << "mode" << std::right << std::setw(6) << "obs" << std::setw(9) << "payload"
+              << std::setw(5) << "thr" << std::setw(13) << "notif/s" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns"
+              << std::setw(10) << "p99.9 ns" << std::setw(11) << "max ns" << "\n";
+
+    const size_t observerCounts[] = {1, 10, 100};
+    for (auto observers : observerCounts) {
+        for (size_t payload : {8, 256, 4096}) {
+            BenchBasic(observers, payload);
+        }
+    }
+    for (auto observers : observerCounts) {
+        BenchManager(observers);
+    }
+    for (auto observers : observerCounts) {
+        for (size_t dispatchers : {1, 2}) {
+            BenchAsyncManager(observers, dispatchers);
+        }
+    }
+    for (auto observers : observerCounts) {
+        BenchSensor(observers, "every", sensor::DeliveryPolicy::Every());
+        BenchSensor(observers, "batch64", sensor::DeliveryPolicy::Batch(64));
+        BenchSensor(observers, "latest1ms", sensor::DeliveryPolicy::Latest(std::chrono::milliseconds{1}));
+    }
+    for (auto observers : observerCounts) {
+        for (size_t threads : {1, 2, 4}) {
+            BenchPerson<person_mutex::Person, person_mutex::PersonListener>("person/mutex", observers, threads);
+            BenchPerson<person_cow::Person, person_cow::PersonListener>("person/cow", observers, threads);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+// Making the observer pattern thread safe without holding a lock during the notification
+//  In observer3.cpp notify() holds the global mutex while it calls every listener :
+//   - a slow listener blocks every other notify(), subscribe() and unsubscribe()
+//   - a listener which calls subscribe() from PersonChanged() deadlocks (the mutex is not recursive)
+//   - every notify() scans the vector for the nulls left by unsubscribe()
+//
+//  Copy-on-write listener list :
+//   - The list of listeners is never modified. subscribe() and unsubscribe() copy it, change the copy
+//     and publish the copy in place of the old one (std::atomic_store of a shared_ptr).
+//   - notify() takes the current list (std::atomic_load) and iterates over it without any lock.
+//     The shared_ptr keeps that list alive until the loop is done, even if it has been replaced.
+//   - subscribe() and unsubscribe() are serialized by a mutex of their own, notify() never takes it.
+//     So they can be called from inside a callback.
+//   - A change made during a notification applies to the next notifications. A listener unsubscribed
+//     by another thread may still get the notification which is already running.
+//  Subscriptions are rare and notifications are frequent, so copying on subscription is cheap.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <boost/any.hpp>
+
+using namespace std;
+using boost::any;
+using boost::any_cast;
+
+struct Person;
+
+struct PersonListener {
+	virtual ~PersonListener() = default;
+	virtual void PersonChanged(Person &p, const string &property_name, const any new_value) = 0;
+};
+
+// A list of listeners which can be iterated while it is changed.
+template <typename T>
+class ObserverList {
+	using List = vector<T*>;
+	shared_ptr<const List> list{ make_shared<List>() };
+	mutex write_mtx;
+
+	// Copies the list, lets change() modify the copy and publishes it.
+	template <typename Fn>
+	void update(Fn change) {
+		lock_guard<mutex> guard{ write_mtx };
+		auto copy = make_shared<List>(*atomic_load(&list));
+		if (change(*copy))
+			atomic_store(&list, shared_ptr<const List>{ move(copy) });
+	}
+public:
+	// To prevent multiple subscriptions by the same listener.
+	void add(T *pl) {
+		update([pl](List &l) {
+			if (find(begin(l), end(l), pl) != end(l))
+				return false;
+			l.push_back(pl);
+			return true;
+		});
+	}
+
+	void remove(T *pl) {
+		update([pl](List &l) {
+			auto it = find(begin(l), end(l), pl);
+			if (it == end(l))
+				return false;
+			l.erase(it);
+			return true;
+		});
+	}
+
+	// The listeners at the time of the call.
+	shared_ptr<const List> snapshot() const {
+		return atomic_load(&list);
+	}
+};
+
+struct Person {
+	explicit Person(int age) : age(age) {}
+
+	virtual int GetAge() const {
+		return age;
+	}
+
+	virtual void SetAge(const int age) {
+		if (this->age.exchange(age) == age)
+			return;
+		notify("age", age);
+	}
+
+	void subscribe(PersonListener *pl) {
+		listeners.add(pl);
+	}
+
+	void unsubscribe(PersonListener *pl) {
+		listeners.remove(pl);
+	}
+
+	// No lock : the snapshot can not change while we iterate over it.
+	void notify(const string &property_name, const any new_value) {
+		auto snapshot = listeners.snapshot();
+		for (const auto listener : *snapshot)
+			listener->PersonChanged(*this, property_name, new_value);
+	}
+private:
+	atomic<int> age;
+	ObserverList<PersonListener> listeners;
+};
+
+// A class that will output to console any changes in person.
+struct ConsoleListener : PersonListener {
+	void PersonChanged(Person &p, const string &property_name, const any new_value) override {
+		cout << "Person's " << property_name << " has been changed to " ;
+		if (property_name == "age") {
+			cout << any_cast<int>(new_value);
+		}
+		cout << endl;
+	}
+};
+
+// Subscribes another listener from inside the callback, and unsubscribes itself.
+// With observer3.cpp this would deadlock.
+struct OneShotListener : PersonListener {
+	PersonListener *next;
+	explicit OneShotListener(PersonListener *next) : next(next) {}
+
+	void PersonChanged(Person &p, const string &, const any) override {
+		cout << "One shot listener : handing over to the console listener" << endl;
+		p.subscribe(next);
+		p.unsubscribe(this);
+	}
+};
+
+struct CountingListener : PersonListener {
+	atomic<int> count{};
+	void PersonChanged(Person &, const string &, const any) override {
+		++count;
+	}
+};
+
+int main() {
+	Person p{14};
+	ConsoleListener cl;
+	OneShotListener once{ &cl };
+	p.subscribe(&once);
+	p.subscribe(&once);
+
+	p.SetAge(15);	// only the one shot listener, it subscribes the console listener for the next change
+	p.SetAge(16);	// only the console listener
+	p.unsubscribe(&cl);
+
+	// Two threads notify while a third one subscribes and unsubscribes.
+	CountingListener counter, other;
+	p.subscribe(&counter);
+	auto change_age = [&p](int from) {
+		for (int i = 0; i < 100000; ++i)
+			p.SetAge(from + i % 2);
+	};
+	thread t1{ change_age, 20 }, t2{ change_age, 40 };
+	thread t3{ [&p, &other]() {
+		for (int i = 0; i < 1000; ++i) {
+			p.subscribe(&other);
+			p.unsubscribe(&other);
+		}
+	} };
+	t1.join();
+	t2.join();
+	t3.join();
+	cout << "Counting listener got " << counter.count << " notifications, the other one " << other.count << endl;
+
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*
+	Shooting actors game
+
+	The ActorPool of 3_multiple_actors_2 identifies the kind of actor by a string key.
+	 - AcquireActor("missile") looks up the key several times in the unordered_map,
+	   and then scans all the missiles linearly to find an invisible one.
+	 - ReleaseActor() ignores its key, so any key can be passed.
+
+	Most of the time the game knows at compile time what it is spawning. So ActorPool
+	now has a typed API : AcquireActor<Missile>().
+	 - Every actor type gets a small integer id, assigned once per type.
+	 - There is one free list per type id. Acquire pops from it and Release pushes on it.
+	   No hashing, no searching.
+	 - Every actor remembers its type id. Thus ReleaseActor() needs no key.
+
+	The string registry is kept for data-driven spawning (e.g. a level file that says
+	"alien"). It maps the key to the type id once and then uses the same free lists.
+*/
+
+// Represents all kinds of actors in the game.
+//////////////////////////////////////////////////
+/////////////////////////// Actor.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <cstddef>
+
+class Actor {
+	bool m_IsVisible{true};
+	// Index of the free list this actor goes back to. Set by the ActorPool.
+	size_t m_PoolId{};
+	friend class ActorPool;
+public:
+	void SetVisible(bool v) { m_IsVisible = v; }
+	bool IsVisible() const { return m_IsVisible; }
+	virtual void Update() = 0;
+	virtual ~Actor() = default;
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Alien.h
+//////////////////////////////////////////////////
+// #pragma once
+class Alien : public Actor{
+public:
+	Alien();
+	~Alien();
+	void Update() override;
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Missile.h
+//////////////////////////////////////////////////
+// #pragma once
+class Missile : public Actor {
+public:
+	Missile();
+	~Missile();
+	// to animate the actor
+	void Update() override;
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Alien.cpp
+//////////////////////////////////////////////////
+#include <iostream>
+
+Alien::Alien() {
+	std::cout << "++++++ Alien()\n";
+}
+
+Alien::~Alien() {
+	std::cout << "~~~~~~ Alien()\n";
+}
+
+void Alien::Update() {
+	std::cout << "@ ";
+}
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Missile.cpp
+//////////////////////////////////////////////////
+#include <iostream>
+
+Missile::Missile() {
+	std::cout << "+++ Missile Created\n";
+}
+
+Missile::~Missile() {
+	std::cout << "~~~ Missile Destroyed\n";
+}
+
+#include<thread>
+void Missile::Update() {
+	std::cout << " -> ";
+	using namespace std;
+	std::this_thread::sleep_for(0.4s);
+}
+
+
+// Instead of new to create actors and Aliens, we use factory method
+//////////////////////////////////////////////////
+/////////////////////////// ActorPool.h
+/////////////////////////// It should be Singleton or Monostate.
+//////////////////////////////////////////////////
+// #pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <functional>
+
+using ActorPtr = std::shared_ptr<Actor>;
+using ActorCreator = std::function<ActorPtr()>;
+
+class ActorPool {
+	struct ActorInfo {
+		std::vector<ActorPtr> m_FreeActors{};
+		ActorCreator m_Creator;
+	};
+	// Indexed by the type id.
+	static std::vector<ActorInfo> m_ActorInfos;
+	// Slow path for data driven spawning.
+	static std::unordered_map<std::string, size_t> m_Registry;
+	ActorPool() = default;
+
+	static size_t NextTypeId();
+	// Returns the same id for all the calls with the same ActorT.
+	template <typename ActorT>
+	static size_t TypeId() {
+		static const size_t id = NextTypeId();
+		return id;
+	}
+	static ActorPtr Acquire(size_t id);
+public:
+	template <typename ActorT>
+	static std::shared_ptr<ActorT> AcquireActor() {
+		size_t id = TypeId<ActorT>();
+		if (!m_ActorInfos[id].m_Creator) {
+			m_ActorInfos[id].m_Creator = []() { return std::make_shared<ActorT>(); };
+		}
+		return std::static_pointer_cast<ActorT>(Acquire(id));
+	}
+	static ActorPtr AcquireActor(const std::string&);
+	static void ReleaseActor(const ActorPtr&);
+
+	template <typename ActorT>
+	static void RegisterCreator(const std::string &key) {
+		size_t id = TypeId<ActorT>();
+		m_ActorInfos[id].m_Creator = []() { return std::make_shared<ActorT>(); };
+		m_Registry[key] = id;
+	}
+};
+
+//////////////////////////////////////////////////
+/////////////////////////// ActorPool.cpp
+//////////////////////////////////////////////////
+std::vector<ActorPool::ActorInfo> ActorPool::m_ActorInfos;
+std::unordered_map<std::string, size_t> ActorPool::m_Registry;
+#include <iostream>
+
+size_t ActorPool::NextTypeId() {
+	m_ActorInfos.emplace_back();
+	return m_ActorInfos.size() - 1;
+}
+
+ActorPtr ActorPool::Acquire(size_t id) {
+	auto &info = m_ActorInfos[id];
+	if (!info.m_FreeActors.empty()) {
+		std::cout << "Using an existing actor\n";
+		auto actor = info.m_FreeActors.back();
+		info.m_FreeActors.pop_back();
+		// Reset state
+		actor->SetVisible(true);
+		return actor;
+	}
+	std::cout << "[Pool] Creating a new actor.\n";
+	auto actor = info.m_Creator();
+	actor->m_PoolId = id;
+	return actor;
+}
+
+ActorPtr ActorPool::AcquireActor(const std::string& key) {
+	auto it = m_Registry.find(key);
+	if (it == end(m_Registry)) {
+		std::cout << "[Pool] Creator for " << key << " is not registered.\n";
+		return nullptr;
+	}
+	return Acquire(it->second);
+}
+
+void ActorPool::ReleaseActor(const ActorPtr &m) {
+	// Already in the free list.
+	if (!m->IsVisible()) {
+		return;
+	}
+	std::cout << "Returning the actor instance.\n";
+	m->SetVisible(false);
+	m_ActorInfos[m->m_PoolId].m_FreeActors.push_back(m);
+}
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+#include <thread>
+#include <vector>
+
+std::vector<std::shared_ptr<Actor>> actors{};
+
+void Fire() {
+	// actors.push_back(std::make_shared<Missile>());
+	// actors.push_back(std::make_shared<Missile>());
+	actors.push_back(ActorPool::AcquireActor<Missile>());
+	// Spawned from data, e.g. a level file.
+	actors.push_back(ActorPool::AcquireActor("alien"));
+}
+
+void Animate() {
+	for (auto &m : actors) {
+		m->Update();
+	}
+}
+
+void Explode() {
+	std::cout << "X\n";
+	for (auto &m : actors) {
+		ActorPool::ReleaseActor(m);
+	}
+	actors.clear();
+	using namespace std;
+	std::this_thread::sleep_for(1s);
+	std::cout << "\n\n";
+}
+
+void GameLoop() {
+	int counter{0};
+	int loop{2};
+	while (loop) {
+		++counter;
+		if (counter == 1) {
+			// Fire the missile.
+			Fire();
+			std::flush(std::cout);
+		} 
+		else if (counter >= 1 && counter <= 5) {
+			// Animate
+			Animate();
+			std::flush(std::cout);
+		}
+		else if (counter > 5) {
+			// Explode
+			Explode();
+			std::flush(std::cout);
+			counter = 0;
+			--loop;
+		}
+	}
+	using namespace std;
+	this_thread::sleep_for(1s);
+}
+
+int main() {
+	ActorPool::RegisterCreator<Alien>("alien");
+	ActorPool::RegisterCreator<Missile>("missile");
+	GameLoop();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+/*
+	Shooting actors game
+
+	Animate() of 3_multiple_actors_3 walks a vector of shared_ptr<Actor> and calls the
+	virtual Update() on each one. Every actor is a separate heap object and its
+	visibility is a flag inside that object.
+	With tens of thousands of missiles per frame, this means
+	 - a cache miss for almost every actor (the objects are scattered on the heap),
+	 - a virtual call that cannot be inlined,
+	 - a branch on IsVisible() for every pooled actor, live or not.
+
+	So we turn the pool inside out (data oriented design, as in an ECS).
+	The pool no longer keeps objects. It keeps one ActorStore per actor type, and the
+	store keeps every field of the actors in its own dense array (structure of arrays).
+	 - The live actors are always packed at the front of the arrays, in [0, Live()).
+	   Releasing an actor swaps the last live actor into its place.
+	   Thus "visible" simply means "inside the live range". No flag, no branch.
+	 - The callers hold an ActorHandle instead of a pointer. The store maps the
+	   handle to the current position in the arrays.
+	 - Update() is a plain loop over the live range which the compiler can
+	   auto-vectorise (try -O3 -fopt-info-vec).
+
+	Note : Just like the pooled objects, the slots are reused after release. Each slot
+		   has a generation which is bumped when its actor is released, and the handle
+		   keeps the generation it was given. A handle kept after its release is stale :
+		   Release() ignores it, IsVisible() is false and X() / Y() are NaN, even when
+		   the slot already holds another actor.
+*/
+
+//////////////////////////////////////////////////
+/////////////////////////// Actors.h
+//////////////////////////////////////////////////
+// #pragma once
+// The actor types are only tags now. Their data lives in the ActorStore.
+struct Missile {
+	static const char* Symbol() { return " -> "; }
+};
+
+struct Alien {
+	static const char* Symbol() { return " @ "; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ActorStore.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <limits>
+
+struct ActorHandle {
+	uint32_t m_Id{};
+	uint32_t m_Generation{};
+};
+
+template <typename ActorT>
+class ActorStore {
+	// One entry per actor. [0, m_Live) are the live actors.
+	std::vector<float> m_PosX;
+	std::vector<float> m_PosY;
+	std::vector<float> m_VelX;
+	std::vector<float> m_VelY;
+	std::vector<uint32_t> m_DenseToHandle;
+	// Indexed by the handle.
+	std::vector<uint32_t> m_HandleToDense;
+	std::vector<uint32_t> m_Generations;
+	size_t m_Live{};
+
+	// False for a handle released since, even if its slot has been reused.
+	bool IsCurrent(ActorHandle h) const {
+		return h.m_Id < m_Generations.size() && m_Generations[h.m_Id] == h.m_Generation;
+	}
+
+	void Swap(size_t a, size_t b) {
+		std::swap(m_PosX[a], m_PosX[b]);
+		std::swap(m_PosY[a], m_PosY[b]);
+		std::swap(m_VelX[a], m_VelX[b]);
+		std::swap(m_VelY[a], m_VelY[b]);
+		std::swap(m_DenseToHandle[a], m_DenseToHandle[b]);
+		m_HandleToDense[m_DenseToHandle[a]] = static_cast<uint32_t>(a);
+		m_HandleToDense[m_DenseToHandle[b]] = static_cast<uint32_t>(b);
+	}
+public:
+	ActorHandle Acquire(float x, float y, float velX, float velY) {
+		if (m_Live == m_PosX.size()) {
+			// No released actor to reuse. Grow all the arrays by one slot.
+			auto handle = static_cast<uint32_t>(m_HandleToDense.size());
+			m_HandleToDense.push_back(static_cast<uint32_t>(m_Live));
+			m_Generations.push_back(0);
+			m_DenseToHandle.push_back(handle);
+			m_PosX.push_back({});
+			m_PosY.push_back({});
+			m_VelX.push_back({});
+			m_VelY.push_back({});
+		}
+		// Reset state
+		m_PosX[m_Live] = x;
+		m_PosY[m_Live] = y;
+		m_VelX[m_Live] = velX;
+		m_VelY[m_Live] = velY;
+		uint32_t handle = m_DenseToHandle[m_Live++];
+		return {handle, m_Generations[handle]};
+	}
+
+	void Release(ActorHandle h) {
+		// Already released.
+		if (!IsCurrent(h)) {
+			return;
+		}
+		++m_Generations[h.m_Id];
+		Swap(m_HandleToDense[h.m_Id], --m_Live);
+	}
+
+	bool IsVisible(ActorHandle h) const {
+		return IsCurrent(h);
+	}
+
+	float X(ActorHandle h) const {
+		return IsCurrent(h) ? m_PosX[m_HandleToDense[h.m_Id]] : std::numeric_limits<float>::quiet_NaN();
+	}
+	float Y(ActorHandle h) const {
+		return IsCurrent(h) ? m_PosY[m_HandleToDense[h.m_Id]] : std::numeric_limits<float>::quiet_NaN();
+	}
+
+	size_t Live() const { return m_Live; }
+	size_t Capacity() const { return m_PosX.size(); }
+
+	// Touches only the live range. No virtual call, no visibility check.
+	void Update(float dt) {
+		float *posX = m_PosX.data();
+		float *posY = m_PosY.data();
+		const float *velX = m_VelX.data();
+		const float *velY = m_VelY.data();
+		const size_t live = m_Live;
+		for (size_t i = 0; i < live; ++i) {
+			posX[i] += velX[i] * dt;
+			posY[i] += velY[i] * dt;
+		}
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ActorPool.h
+/////////////////////////// It should be Singleton or Monostate.
+//////////////////////////////////////////////////
+// #pragma once
+class ActorPool {
+	using Updater = void (*)(float);
+	// One entry per actor type, added when the type's store is first used.
+	static std::vector<Updater> m_Updaters;
+	ActorPool() = default;
+public:
+	template <typename ActorT>
+	static ActorStore<ActorT>& Store() {
+		static ActorStore<ActorT> store;
+		static bool registered = (m_Updaters.push_back([](float dt) { store.Update(dt); }), true);
+		(void)registered;
+		return store;
+	}
+
+	template <typename ActorT>
+	static ActorHandle AcquireActor(float x, float y, float velX, float velY) {
+		return Store<ActorT>().Acquire(x, y, velX, velY);
+	}
+
+	template <typename ActorT>
+	static void ReleaseActor(ActorHandle h) {
+		Store<ActorT>().Release(h);
+	}
+
+	// Updates the actors of all the types, one tight loop per type.
+	static void Update(float dt) {
+		for (auto update : m_Updaters) {
+			update(dt);
+		}
+	}
+};
+
+//////////////////////////////////////////////////
+/////////////////////////// ActorPool.cpp
+//////////////////////////////////////////////////
+std::vector<ActorPool::Updater> ActorPool::m_Updaters;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+#include <iostream>
+
+std::vector<ActorHandle> missiles{};
+std::vector<ActorHandle> aliens{};
+
+void Fire() {
+	for (int i = 0; i < 20000; ++i) {
+		missiles.push_back(ActorPool::AcquireActor<Missile>(0.0f, float(i), 10.0f, 0.0f));
+	}
+	for (int i = 0; i < 200; ++i) {
+		aliens.push_back(ActorPool::AcquireActor<Alien>(500.0f, float(i), -1.0f, 0.5f));
+	}
+}
+
+void Animate() {
+	ActorPool::Update(1.0f / 60);
+}
+
+template <typename ActorT>
+void Print() {
+	auto &store = ActorPool::Store<ActorT>();
+	std::cout << ActorT::Symbol() << " live : " << store.Live() << "  pooled : " << store.Capacity() << "\n";
+}
+
+void Explode() {
+	std::cout << "X\n";
+	// Missiles are released in a different order than they were fired.
+	for (auto it = missiles.rbegin(); it != missiles.rend(); ++it) {
+		ActorPool::ReleaseActor<Missile>(*it);
+	}
+	for (auto h : aliens) {
+		ActorPool::ReleaseActor<Alien>(h);
+	}
+	missiles.clear();
+	aliens.clear();
+}
+
+void GameLoop() {
+	for (int loop = 0; loop < 2; ++loop) {
+		Fire();
+		for (int frame = 0; frame < 60; ++frame) {
+			Animate();
+		}
+		Print<Missile>();
+		Print<Alien>();
+		auto &store = ActorPool::Store<Missile>();
+		std::cout << "Missile " << missiles[1].m_Id << " is at (" << store.X(missiles[1]) << ", " << store.Y(missiles[1]) << ")\n";
+		auto stale = missiles[1];
+		Explode();
+		Print<Missile>();
+		std::cout << "Released missile " << stale.m_Id << " visible : " << store.IsVisible(stale) << "\n";
+		std::cout << "\n";
+	}
+}
+
+int main() {
+	GameLoop();
+
+	return 0;
+}
@@ -0,0 +1,257 @@
+/*
+	Shooting actors game
+
+	The pool in 4_generic_pool_2 is threadsafe, but every Acquire() and Release()
+	takes the same mutex and touches the same vector. When many threads churn objects
+	the cache line holding the pool's head keeps bouncing between the cores.
+
+	Memory allocators like tcmalloc or jemalloc solve this with per-thread caches
+	(also called magazines).
+	 - Each thread owns a small cache of free objects. Acquire() and Release() use only
+	   this cache, so they don't need a lock.
+	 - When the cache runs empty, it fetches a batch of objects from the global pool.
+	 - When the cache overflows, it returns a batch to the global pool.
+	Thus the global lock is taken once per BatchSize operations instead of once per operation.
+
+	The statistics are also kept per thread. Each thread cache counts its own
+	acquires and releases. InUse() and Free() add up these counters only when asked.
+	No global locked int is updated on the fast path.
+
+	Note : An object may be released on a different thread than the one that acquired it.
+		   It simply goes into the releasing thread's cache.
+*/
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Allocator.h
+//////////////////////////////////////////////////
+template <typename T>
+class DefaultAllocator {
+public:
+	T* operator()() {
+		return new T{};
+	}
+
+	void operator()(T* p){
+		delete p;
+	}
+
+	// to reset the state of the allocator when you call Destory() on object pool.
+	void Reset() {
+
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ObjectPool.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+template <typename T, typename AllocatorT=DefaultAllocator<T>, size_t BatchSize=8>
+class ObjectPool {
+	// Magazine owned by a single thread.
+	// m_Acquired and m_Released are written only by the owner thread but are read
+	// by InUse() and Free() on other threads, hence they are atomics.
+	struct ThreadCache {
+		T *m_pObjects[2 * BatchSize];
+		std::atomic<size_t> m_Count{0};
+		std::atomic<long> m_Acquired{0};
+		std::atomic<long> m_Released{0};
+
+		ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Caches.push_back(this);
+		}
+		// Thread is exiting. Give the cached objects back to the global pool.
+		~ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			size_t count = m_Count.load(std::memory_order_relaxed);
+			m_FreeObjects.insert(end(m_FreeObjects), m_pObjects, m_pObjects + count);
+			m_RetiredAcquired += m_Acquired.load(std::memory_order_relaxed);
+			m_RetiredReleased += m_Released.load(std::memory_order_relaxed);
+			m_Caches.erase(std::find(begin(m_Caches), end(m_Caches), this));
+		}
+	};
+
+	// Protects everything below. Taken only on the slow path.
+	static std::mutex mtx;
+	static std::vector<T*> m_PooledObjects;
+	static std::vector<T*> m_FreeObjects;
+	static std::vector<ThreadCache*> m_Caches;
+	// Counters of the threads that have already exited.
+	static long m_RetiredAcquired;
+	static long m_RetiredReleased;
+	static AllocatorT m_Allocator;
+
+	static thread_local ThreadCache m_Cache;
+
+	// Cache is empty. Move a batch from the global pool, creating new objects if needed.
+	static void Refill(ThreadCache &cache) {
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count{0};
+		while (count < BatchSize && !m_FreeObjects.empty()) {
+			cache.m_pObjects[count++] = m_FreeObjects.back();
+			m_FreeObjects.pop_back();
+		}
+		if (count < BatchSize) {
+			std::cout << "[POOL] Creating " << BatchSize - count << " new objects.\n";
+		}
+		while (count < BatchSize) {
+			auto pObj = m_Allocator();
+			m_PooledObjects.push_back(pObj);
+			cache.m_pObjects[count++] = pObj;
+		}
+		cache.m_Count.store(count, std::memory_order_relaxed);
+	}
+
+	// Cache is full. Move the older half back to the global pool.
+	static void Flush(ThreadCache &cache) {
+		std::lock_guard<std::mutex> lock(mtx);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + BatchSize);
+		std::copy(cache.m_pObjects + BatchSize, cache.m_pObjects + 2 * BatchSize, cache.m_pObjects);
+		cache.m_Count.store(BatchSize, std::memory_order_relaxed);
+	}
+public:
+	static T* Acquire() {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 0) {
+			Refill(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed) - 1;
+		cache.m_Count.store(count, std::memory_order_relaxed);
+		cache.m_Acquired.store(cache.m_Acquired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return cache.m_pObjects[count];
+	}
+
+	static void Release(T *pObj) {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 2 * BatchSize) {
+			Flush(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		cache.m_pObjects[count] = pObj;
+		cache.m_Count.store(count + 1, std::memory_order_relaxed);
+		cache.m_Released.store(cache.m_Released.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	// Aggregated on demand from all the thread caches.
+	static long InUse() {
+		std::lock_guard<std::mutex> lock(mtx);
+		long inUse = m_RetiredAcquired - m_RetiredReleased;
+		for (auto pCache : m_Caches) {
+			inUse += pCache->m_Acquired.load(std::memory_order_relaxed);
+			inUse -= pCache->m_Released.load(std::memory_order_relaxed);
+		}
+		return inUse;
+	}
+
+	static long Free() {
+		std::lock_guard<std::mutex> lock(mtx);
+		long free = m_FreeObjects.size();
+		for (auto pCache : m_Caches) {
+			free += pCache->m_Count.load(std::memory_order_relaxed);
+		}
+		return free;
+	}
+
+	// Call it after all the other threads using the pool have finished.
+	static void Destroy() {
+		// Touch the cache before locking, its constructor takes the lock.
+		auto &cache = m_Cache;
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + count);
+		cache.m_Count.store(0, std::memory_order_relaxed);
+		if (m_FreeObjects.size() != m_PooledObjects.size()) {
+			std::cout << "[WARNING] Deleting objects still in use.\n";
+		}
+		std::cout << "[POOL] Deleting " << m_PooledObjects.size() << " objects.\n";
+		for (auto pObj : m_PooledObjects) {
+			m_Allocator(pObj);
+		}
+		m_Allocator.Reset();
+		m_PooledObjects.clear();
+		m_FreeObjects.clear();
+	}
+};
+
+
+
+template <typename T, typename A, size_t B>
+std::mutex ObjectPool<T, A, B>::mtx;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_PooledObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_FreeObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<typename ObjectPool<T, A, B>::ThreadCache*> ObjectPool<T, A, B>::m_Caches;
+
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_RetiredAcquired{0};
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_RetiredReleased{0};
+
+template <typename T, typename A, size_t B>
+A ObjectPool<T, A, B>::m_Allocator;
+
+template <typename T, typename A, size_t B>
+thread_local typename ObjectPool<T, A, B>::ThreadCache ObjectPool<T, A, B>::m_Cache;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+using IntPool = ObjectPool<int>;
+
+// Each thread acquires and releases objects in a loop.
+// Only every BatchSize-th call goes to the global pool.
+void Churn() {
+	int *objects[20];
+	for (int round = 0; round < 1000; ++round) {
+		for (auto &p : objects) {
+			p = IntPool::Acquire();
+			*p = round;
+		}
+		for (auto p : objects) {
+			IntPool::Release(p);
+		}
+	}
+}
+
+int main() {
+	std::thread t1(Churn);
+	std::thread t2(Churn);
+	std::thread t3(Churn);
+
+	auto p1 = IntPool::Acquire();
+	*p1 = 1;
+	auto p2 = IntPool::Acquire();
+	*p2 = 2;
+
+	std::cout << "InUse : " << IntPool::InUse() << "   Free : " << IntPool::Free() << std::endl;
+
+	t1.join();
+	t2.join();
+	t3.join();
+
+	IntPool::Release(p1);
+	IntPool::Release(p2);
+
+	std::cout << "InUse : " << IntPool::InUse() << "   Free : " << IntPool::Free() << std::endl;
+
+	IntPool::Destroy();
+
+	return 0;
+}
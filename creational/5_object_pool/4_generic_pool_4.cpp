@@ -0,0 +1,319 @@
+/*
+	Shooting actors game
+
+	DefaultAllocator creates every object separately with new T{}. So the pooled objects
+	end up scattered all over the heap. When the game loop walks over the actors to
+	animate them, almost every object is a cache miss.
+
+	Here we provide another allocation strategy for the ObjectPool => SlabAllocator.
+	 - It allocates a large chunk (slab) that has room for ObjectsPerSlab objects.
+	   The storage is aligned for T.
+	 - The objects are constructed in place inside the slab with placement new.
+	 - When a slab is full, the next allocation grabs a new slab. Thus the pool
+	   grows chunk-by-chunk instead of object-by-object.
+	 - Releasing an object only calls its destructor. The memory goes away when
+	   Destroy() calls Reset(), which frees whole slabs at once.
+
+	As the pool keeps the objects in the order they were created, ForEach() now walks
+	the memory sequentially.
+*/
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Allocator.h
+//////////////////////////////////////////////////
+#include <vector>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <cstddef>
+#include <iostream>
+
+template <typename T>
+class DefaultAllocator {
+public:
+	T* operator()() {
+		return new T{};
+	}
+
+	void operator()(T* p){
+		delete p;
+	}
+
+	// to reset the state of the allocator when you call Destory() on object pool.
+	void Reset() {
+
+	}
+};
+
+
+template <typename T, size_t ObjectsPerSlab=64>
+class SlabAllocator {
+	using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+	struct Slab {
+		Storage m_Objects[ObjectsPerSlab];
+	};
+	std::vector<std::unique_ptr<Slab>> m_Slabs;
+	// Number of objects carved out of the last slab.
+	size_t m_Used{ObjectsPerSlab};
+public:
+	T* operator()() {
+		if (m_Used == ObjectsPerSlab) {
+			std::cout << "[SLAB] Allocating a slab of " << ObjectsPerSlab << " objects.\n";
+			m_Slabs.push_back(std::make_unique<Slab>());
+			m_Used = 0;
+		}
+		return new (&m_Slabs.back()->m_Objects[m_Used++]) T{};
+	}
+
+	// Memory stays in the slab, it is freed by Reset().
+	void operator()(T* p){
+		p->~T();
+	}
+
+	void Reset() {
+		std::cout << "[SLAB] Freeing " << m_Slabs.size() << " slabs.\n";
+		m_Slabs.clear();
+		m_Used = ObjectsPerSlab;
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ObjectPool.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+template <typename T, typename AllocatorT=DefaultAllocator<T>, size_t BatchSize=8>
+class ObjectPool {
+	// Magazine owned by a single thread.
+	// m_Acquired and m_Released are written only by the owner thread but are read
+	// by InUse() and Free() on other threads, hence they are atomics.
+	struct ThreadCache {
+		T *m_pObjects[2 * BatchSize];
+		std::atomic<size_t> m_Count{0};
+		std::atomic<long> m_Acquired{0};
+		std::atomic<long> m_Released{0};
+
+		ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Caches.push_back(this);
+		}
+		// Thread is exiting. Give the cached objects back to the global pool.
+		~ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			size_t count = m_Count.load(std::memory_order_relaxed);
+			m_FreeObjects.insert(end(m_FreeObjects), m_pObjects, m_pObjects + count);
+			m_RetiredAcquired += m_Acquired.load(std::memory_order_relaxed);
+			m_RetiredReleased += m_Released.load(std::memory_order_relaxed);
+			m_Caches.erase(std::find(begin(m_Caches), end(m_Caches), this));
+		}
+	};
+
+	// Protects everything below. Taken only on the slow path.
+	static std::mutex mtx;
+	static std::vector<T*> m_PooledObjects;
+	static std::vector<T*> m_FreeObjects;
+	static std::vector<ThreadCache*> m_Caches;
+	// Counters of the threads that have already exited.
+	static long m_RetiredAcquired;
+	static long m_RetiredReleased;
+	static AllocatorT m_Allocator;
+
+	static thread_local ThreadCache m_Cache;
+
+	// Cache is empty. Move a batch from the global pool, creating new objects if needed.
+	static void Refill(ThreadCache &cache) {
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count{0};
+		while (count < BatchSize && !m_FreeObjects.empty()) {
+			cache.m_pObjects[count++] = m_FreeObjects.back();
+			m_FreeObjects.pop_back();
+		}
+		if (count < BatchSize) {
+			std::cout << "[POOL] Creating " << BatchSize - count << " new objects.\n";
+		}
+		while (count < BatchSize) {
+			auto pObj = m_Allocator();
+			m_PooledObjects.push_back(pObj);
+			cache.m_pObjects[count++] = pObj;
+		}
+		cache.m_Count.store(count, std::memory_order_relaxed);
+	}
+
+	// Cache is full. Move the older half back to the global pool.
+	static void Flush(ThreadCache &cache) {
+		std::lock_guard<std::mutex> lock(mtx);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + BatchSize);
+		std::copy(cache.m_pObjects + BatchSize, cache.m_pObjects + 2 * BatchSize, cache.m_pObjects);
+		cache.m_Count.store(BatchSize, std::memory_order_relaxed);
+	}
+public:
+	static T* Acquire() {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 0) {
+			Refill(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed) - 1;
+		cache.m_Count.store(count, std::memory_order_relaxed);
+		cache.m_Acquired.store(cache.m_Acquired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return cache.m_pObjects[count];
+	}
+
+	static void Release(T *pObj) {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 2 * BatchSize) {
+			Flush(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		cache.m_pObjects[count] = pObj;
+		cache.m_Count.store(count + 1, std::memory_order_relaxed);
+		cache.m_Released.store(cache.m_Released.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	// Aggregated on demand from all the thread caches.
+	static long InUse() {
+		std::lock_guard<std::mutex> lock(mtx);
+		long inUse = m_RetiredAcquired - m_RetiredReleased;
+		for (auto pCache : m_Caches) {
+			inUse += pCache->m_Acquired.load(std::memory_order_relaxed);
+			inUse -= pCache->m_Released.load(std::memory_order_relaxed);
+		}
+		return inUse;
+	}
+
+	static long Free() {
+		std::lock_guard<std::mutex> lock(mtx);
+		long free = m_FreeObjects.size();
+		for (auto pCache : m_Caches) {
+			free += pCache->m_Count.load(std::memory_order_relaxed);
+		}
+		return free;
+	}
+
+	// Visits every pooled object, free or in use, in the order they were created.
+	template <typename Fn>
+	static void ForEach(Fn fn) {
+		std::lock_guard<std::mutex> lock(mtx);
+		for (auto pObj : m_PooledObjects) {
+			fn(*pObj);
+		}
+	}
+
+	// Call it after all the other threads using the pool have finished.
+	static void Destroy() {
+		// Touch the cache before locking, its constructor takes the lock.
+		auto &cache = m_Cache;
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + count);
+		cache.m_Count.store(0, std::memory_order_relaxed);
+		if (m_FreeObjects.size() != m_PooledObjects.size()) {
+			std::cout << "[WARNING] Deleting objects still in use.\n";
+		}
+		std::cout << "[POOL] Deleting " << m_PooledObjects.size() << " objects.\n";
+		for (auto pObj : m_PooledObjects) {
+			m_Allocator(pObj);
+		}
+		m_Allocator.Reset();
+		m_PooledObjects.clear();
+		m_FreeObjects.clear();
+	}
+};
+
+
+
+template <typename T, typename A, size_t B>
+std::mutex ObjectPool<T, A, B>::mtx;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_PooledObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_FreeObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<typename ObjectPool<T, A, B>::ThreadCache*> ObjectPool<T, A, B>::m_Caches;
+
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_RetiredAcquired{0};
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_RetiredReleased{0};
+
+template <typename T, typename A, size_t B>
+A ObjectPool<T, A, B>::m_Allocator;
+
+template <typename T, typename A, size_t B>
+thread_local typename ObjectPool<T, A, B>::ThreadCache ObjectPool<T, A, B>::m_Cache;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Missile.h
+//////////////////////////////////////////////////
+// #pragma once
+class Missile {
+	bool m_IsVisible{true};
+	int m_Position{};
+public:
+	// Reset state when the missile is reused.
+	void Launch() { m_IsVisible = true; m_Position = 0; }
+	void SetVisible(bool v) { m_IsVisible = v; }
+	bool IsVisible() const { return m_IsVisible; }
+	int Position() const { return m_Position; }
+	void Update() { ++m_Position; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+using MissilePool = ObjectPool<Missile, SlabAllocator<Missile>>;
+
+std::vector<Missile*> missiles{};
+
+void Fire() {
+	for (int i = 0; i < 100; ++i) {
+		auto m = MissilePool::Acquire();
+		m->Launch();
+		missiles.push_back(m);
+	}
+}
+
+// The missiles are packed in the slabs, so this is a sequential walk over memory.
+void Animate() {
+	MissilePool::ForEach([](Missile &m) {
+		if (m.IsVisible()) {
+			m.Update();
+		}
+	});
+}
+
+void Explode() {
+	for (auto m : missiles) {
+		m->SetVisible(false);
+		MissilePool::Release(m);
+	}
+	missiles.clear();
+}
+
+int main() {
+	for (int loop = 0; loop < 3; ++loop) {
+		Fire();
+		for (int frame = 0; frame < 5; ++frame) {
+			Animate();
+		}
+		std::cout << "First missile reached " << missiles.front()->Position() << "\n";
+		Explode();
+	}
+
+	std::cout << "InUse : " << MissilePool::InUse() << "   Free : " << MissilePool::Free() << std::endl;
+
+	MissilePool::Destroy();
+
+	return 0;
+}
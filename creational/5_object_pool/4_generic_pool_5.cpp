@@ -0,0 +1,448 @@
+/*
+	Shooting actors game
+
+	Callers of ObjectPool::Acquire() must remember to call Release() on the raw pointer.
+	It is easy to get wrong. In 4_generic_pool_2 seq1() and seq2() never release some
+	of their objects (the slots leak) and seq1() releases p1 twice.
+
+	MissilePool avoided this by handing out shared_ptr. But it pays for a reference count
+	and a control block for every missile, though a missile has only one owner.
+
+	PooledPtr<T> is a move-only handle (like unique_ptr).
+	 - It gives the object back to its pool in its destructor.
+	 - It cannot be copied, so there is no reference count.
+	 - It is as big as a raw pointer.
+
+	With POOL_CHECK_RELEASE defined (-D POOL_CHECK_RELEASE) the pool also remembers which
+	objects are handed out. Releasing an object that is not in use (double release, or a
+	pointer that does not belong to the pool) is reported and ignored instead of corrupting
+	the pool. It takes the global lock on every Acquire() and Release(), which the thread
+	caches are there to avoid, so it is off by default.
+*/
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Allocator.h
+//////////////////////////////////////////////////
+#include <vector>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <cstddef>
+#include <iostream>
+
+template <typename T>
+class DefaultAllocator {
+public:
+	T* operator()() {
+		return new T{};
+	}
+
+	void operator()(T* p){
+		delete p;
+	}
+
+	// to reset the state of the allocator when you call Destory() on object pool.
+	void Reset() {
+
+	}
+};
+
+
+template <typename T, size_t ObjectsPerSlab=64>
+class SlabAllocator {
+	using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+	struct Slab {
+		Storage m_Objects[ObjectsPerSlab];
+	};
+	std::vector<std::unique_ptr<Slab>> m_Slabs;
+	// Number of objects carved out of the last slab.
+	size_t m_Used{ObjectsPerSlab};
+public:
+	T* operator()() {
+		if (m_Used == ObjectsPerSlab) {
+			std::cout << "[SLAB] Allocating a slab of " << ObjectsPerSlab << " objects.\n";
+			m_Slabs.push_back(std::make_unique<Slab>());
+			m_Used = 0;
+		}
+		return new (&m_Slabs.back()->m_Objects[m_Used++]) T{};
+	}
+
+	// Memory stays in the slab, it is freed by Reset().
+	void operator()(T* p){
+		p->~T();
+	}
+
+	void Reset() {
+		std::cout << "[SLAB] Freeing " << m_Slabs.size() << " slabs.\n";
+		m_Slabs.clear();
+		m_Used = ObjectsPerSlab;
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// PooledPtr.h
+//////////////////////////////////////////////////
+// #pragma once
+template <typename T, typename PoolT>
+class PooledPtr {
+	T *m_pObject{};
+public:
+	PooledPtr() = default;
+	explicit PooledPtr(T *pObj) : m_pObject{pObj} {}
+
+	PooledPtr(const PooledPtr&) = delete;
+	PooledPtr& operator=(const PooledPtr&) = delete;
+
+	PooledPtr(PooledPtr &&other) noexcept : m_pObject{other.m_pObject} {
+		other.m_pObject = nullptr;
+	}
+	PooledPtr& operator=(PooledPtr &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			m_pObject = other.m_pObject;
+			other.m_pObject = nullptr;
+		}
+		return *this;
+	}
+
+	~PooledPtr() {
+		Reset();
+	}
+
+	// Gives the object back to the pool now.
+	void Reset() {
+		if (m_pObject) {
+			PoolT::Release(m_pObject);
+			m_pObject = nullptr;
+		}
+	}
+
+	T* Get() const { return m_pObject; }
+	T* operator->() const { return m_pObject; }
+	T& operator*() const { return *m_pObject; }
+	explicit operator bool() const { return m_pObject != nullptr; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ObjectPool.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <unordered_set>
+
+template <typename T, typename AllocatorT=DefaultAllocator<T>, size_t BatchSize=8>
+class ObjectPool {
+	// Magazine owned by a single thread.
+	// m_Acquired and m_Released are written only by the owner thread but are read
+	// by InUse() and Free() on other threads, hence they are atomics.
+	struct ThreadCache {
+		T *m_pObjects[2 * BatchSize];
+		std::atomic<size_t> m_Count{0};
+		std::atomic<long> m_Acquired{0};
+		std::atomic<long> m_Released{0};
+
+		ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Caches.push_back(this);
+		}
+		// Thread is exiting. Give the cached objects back to the global pool.
+		~ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			size_t count = m_Count.load(std::memory_order_relaxed);
+			m_FreeObjects.insert(end(m_FreeObjects), m_pObjects, m_pObjects + count);
+			m_RetiredAcquired += m_Acquired.load(std::memory_order_relaxed);
+			m_RetiredReleased += m_Released.load(std::memory_order_relaxed);
+			m_Caches.erase(std::find(begin(m_Caches), end(m_Caches), this));
+		}
+	};
+
+	// Protects everything below. Taken only on the slow path.
+	static std::mutex mtx;
+	static std::vector<T*> m_PooledObjects;
+	static std::vector<T*> m_FreeObjects;
+	static std::vector<ThreadCache*> m_Caches;
+	// Counters of the threads that have already exited.
+	static long m_RetiredAcquired;
+	static long m_RetiredReleased;
+	static AllocatorT m_Allocator;
+
+	static thread_local ThreadCache m_Cache;
+
+#ifdef POOL_CHECK_RELEASE
+	// Objects that are handed out. Used to catch double release.
+	static std::unordered_set<const T*> m_Outstanding;
+#endif
+
+	// Cache is empty. Move a batch from the global pool, creating new objects if needed.
+	static void Refill(ThreadCache &cache) {
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count{0};
+		while (count < BatchSize && !m_FreeObjects.empty()) {
+			cache.m_pObjects[count++] = m_FreeObjects.back();
+			m_FreeObjects.pop_back();
+		}
+		if (count < BatchSize) {
+			std::cout << "[POOL] Creating " << BatchSize - count << " new objects.\n";
+		}
+		while (count < BatchSize) {
+			auto pObj = m_Allocator();
+			m_PooledObjects.push_back(pObj);
+			cache.m_pObjects[count++] = pObj;
+		}
+		cache.m_Count.store(count, std::memory_order_relaxed);
+	}
+
+	// Cache is full. Move the older half back to the global pool.
+	static void Flush(ThreadCache &cache) {
+		std::lock_guard<std::mutex> lock(mtx);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + BatchSize);
+		std::copy(cache.m_pObjects + BatchSize, cache.m_pObjects + 2 * BatchSize, cache.m_pObjects);
+		cache.m_Count.store(BatchSize, std::memory_order_relaxed);
+	}
+public:
+	static T* Acquire() {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 0) {
+			Refill(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed) - 1;
+		cache.m_Count.store(count, std::memory_order_relaxed);
+		cache.m_Acquired.store(cache.m_Acquired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#ifdef POOL_CHECK_RELEASE
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Outstanding.insert(cache.m_pObjects[count]);
+		}
+#endif
+		return cache.m_pObjects[count];
+	}
+
+	using Ptr = PooledPtr<T, ObjectPool>;
+
+	// Preferred over Acquire(). The object returns to the pool when the handle goes away.
+	static Ptr AcquirePtr() {
+		return Ptr{Acquire()};
+	}
+
+	static void Release(T *pObj) {
+		auto &cache = m_Cache;
+#ifdef POOL_CHECK_RELEASE
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (m_Outstanding.erase(pObj) == 0) {
+				std::cout << "[POOL] Releasing an object which is not in use : " << pObj << "\n";
+				return;
+			}
+		}
+#endif
+		if (cache.m_Count.load(std::memory_order_relaxed) == 2 * BatchSize) {
+			Flush(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		cache.m_pObjects[count] = pObj;
+		cache.m_Count.store(count + 1, std::memory_order_relaxed);
+		cache.m_Released.store(cache.m_Released.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	// Aggregated on demand from all the thread caches.
+	static long InUse() {
+		std::lock_guard<std::mutex> lock(mtx);
+		long inUse = m_RetiredAcquired - m_RetiredReleased;
+		for (auto pCache : m_Caches) {
+			inUse += pCache->m_Acquired.load(std::memory_order_relaxed);
+			inUse -= pCache->m_Released.load(std::memory_order_relaxed);
+		}
+		return inUse;
+	}
+
+	static long Free() {
+		std::lock_guard<std::mutex> lock(mtx);
+		long free = m_FreeObjects.size();
+		for (auto pCache : m_Caches) {
+			free += pCache->m_Count.load(std::memory_order_relaxed);
+		}
+		return free;
+	}
+
+	// Visits every pooled object, free or in use, in the order they were created.
+	template <typename Fn>
+	static void ForEach(Fn fn) {
+		std::lock_guard<std::mutex> lock(mtx);
+		for (auto pObj : m_PooledObjects) {
+			fn(*pObj);
+		}
+	}
+
+	// Call it after all the other threads using the pool have finished.
+	static void Destroy() {
+		// Touch the cache before locking, its constructor takes the lock.
+		auto &cache = m_Cache;
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + count);
+		cache.m_Count.store(0, std::memory_order_relaxed);
+		if (m_FreeObjects.size() != m_PooledObjects.size()) {
+			std::cout << "[WARNING] Deleting objects still in use.\n";
+		}
+		std::cout << "[POOL] Deleting " << m_PooledObjects.size() << " objects.\n";
+		for (auto pObj : m_PooledObjects) {
+			m_Allocator(pObj);
+		}
+		m_Allocator.Reset();
+		m_PooledObjects.clear();
+		m_FreeObjects.clear();
+#ifdef POOL_CHECK_RELEASE
+		m_Outstanding.clear();
+#endif
+	}
+};
+
+
+
+template <typename T, typename A, size_t B>
+std::mutex ObjectPool<T, A, B>::mtx;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_PooledObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_FreeObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<typename ObjectPool<T, A, B>::ThreadCache*> ObjectPool<T, A, B>::m_Caches;
+
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_RetiredAcquired{0};
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_RetiredReleased{0};
+
+template <typename T, typename A, size_t B>
+A ObjectPool<T, A, B>::m_Allocator;
+
+#ifdef POOL_CHECK_RELEASE
+template <typename T, typename A, size_t B>
+std::unordered_set<const T*> ObjectPool<T, A, B>::m_Outstanding;
+#endif
+
+template <typename T, typename A, size_t B>
+thread_local typename ObjectPool<T, A, B>::ThreadCache ObjectPool<T, A, B>::m_Cache;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Missile.h
+//////////////////////////////////////////////////
+// #pragma once
+class Missile {
+	int m_Position{};
+public:
+	// Reset state when the missile is reused.
+	void Launch() { m_Position = 0; }
+	int Position() const { return m_Position; }
+	void Update() { ++m_Position; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+using IntPool = ObjectPool<int>;
+
+// Same sequences as in 4_generic_pool_2, but nothing leaks and nothing is released twice.
+void seq1() {
+	{
+		auto p1 = IntPool::AcquirePtr();
+		*p1 = 1;
+	}
+	auto p2 = IntPool::AcquirePtr();
+	*p2 = 2;
+	auto p3 = IntPool::AcquirePtr();
+	*p3 = 3;
+
+	p2.Reset();
+
+	auto p4 = IntPool::AcquirePtr();
+	*p4 = 4;
+}
+
+void seq2() {
+	auto p1 = IntPool::AcquirePtr();
+	*p1 = 1;
+	auto p2 = IntPool::AcquirePtr();
+	*p2 = 2;
+	auto p3 = IntPool::AcquirePtr();
+	*p3 = 3;
+	auto p5 = IntPool::AcquirePtr();
+	*p5 = 3;
+
+	p1.Reset();
+
+	auto p4 = IntPool::AcquirePtr();
+	*p4 = 4;
+}
+
+
+using MissilePool = ObjectPool<Missile, SlabAllocator<Missile>>;
+// No reference count, unlike the shared_ptr used by MissilePool in 2_missile_game_2.
+using MissilePtr = MissilePool::Ptr;
+
+std::vector<MissilePtr> missiles{};
+
+void Fire() {
+	for (int i = 0; i < 10; ++i) {
+		auto m = MissilePool::AcquirePtr();
+		m->Launch();
+		missiles.push_back(std::move(m));
+	}
+}
+
+void Animate() {
+	for (auto &m : missiles) {
+		m->Update();
+	}
+}
+
+// Clearing the vector gives all the missiles back to the pool.
+void Explode() {
+	missiles.clear();
+}
+
+int main() {
+	std::thread t1(seq1);
+	std::thread t2(seq2);
+	std::thread t3(seq1);
+	t1.join();
+	t2.join();
+	t3.join();
+
+	std::cout << "InUse : " << IntPool::InUse() << "   Free : " << IntPool::Free() << std::endl;
+
+	// Raw pointers are still allowed. A double release is caught with POOL_CHECK_RELEASE.
+	auto p = IntPool::Acquire();
+	IntPool::Release(p);
+#ifdef POOL_CHECK_RELEASE
+	IntPool::Release(p);
+#endif
+
+	IntPool::Destroy();
+
+	for (int loop = 0; loop < 2; ++loop) {
+		Fire();
+		for (int frame = 0; frame < 5; ++frame) {
+			Animate();
+		}
+		std::cout << "First missile reached " << missiles.front()->Position() << "\n";
+		Explode();
+	}
+
+	std::cout << "InUse : " << MissilePool::InUse() << "   Free : " << MissilePool::Free() << std::endl;
+	MissilePool::Destroy();
+
+	return 0;
+}
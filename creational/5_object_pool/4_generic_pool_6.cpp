@@ -0,0 +1,318 @@
+/*
+	Shooting actors game
+
+	ObjectPool::Acquire() never fails. When there is no free object it asks the
+	allocator for a new one. Under overload (say a burst of requests) the pool keeps
+	growing until the process runs out of memory.
+
+	So we bound the pool. SetCapacity() limits how many objects the pool may create.
+	When all of them are in use, a caller can choose how to wait :
+	 - Acquire()          blocks on a condition variable until another thread releases an object.
+	 - Acquire(timeout)   waits at most timeout, then returns nullptr.
+	 - TryAcquire()       never waits, returns nullptr right away.
+	Capacity 0 means unbounded, which is the old behaviour.
+
+	Prewarm() creates objects up to a minimum size at startup. Thus the first requests
+	do not pay for constructing the objects.
+
+	With POOL_CHECK_RELEASE defined (-D POOL_CHECK_RELEASE) the pool remembers which objects
+	are handed out, as in 4_generic_pool_5, and reports a double release instead of
+	corrupting the free list. It is off by default.
+
+	Note : Here the free objects live only in the global free list. With the per-thread
+		   caches of 4_generic_pool_3 a free object could sit in another thread's cache
+		   while a caller blocks, though the pool is not really exhausted.
+*/
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Allocator.h
+//////////////////////////////////////////////////
+template <typename T>
+class DefaultAllocator {
+public:
+	T* operator()() {
+		return new T{};
+	}
+
+	void operator()(T* p){
+		delete p;
+	}
+
+	// to reset the state of the allocator when you call Destory() on object pool.
+	void Reset() {
+
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// PooledPtr.h
+//////////////////////////////////////////////////
+// #pragma once
+template <typename T, typename PoolT>
+class PooledPtr {
+	T *m_pObject{};
+public:
+	PooledPtr() = default;
+	explicit PooledPtr(T *pObj) : m_pObject{pObj} {}
+
+	PooledPtr(const PooledPtr&) = delete;
+	PooledPtr& operator=(const PooledPtr&) = delete;
+
+	PooledPtr(PooledPtr &&other) noexcept : m_pObject{other.m_pObject} {
+		other.m_pObject = nullptr;
+	}
+	PooledPtr& operator=(PooledPtr &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			m_pObject = other.m_pObject;
+			other.m_pObject = nullptr;
+		}
+		return *this;
+	}
+
+	~PooledPtr() {
+		Reset();
+	}
+
+	// Gives the object back to the pool now.
+	void Reset() {
+		if (m_pObject) {
+			PoolT::Release(m_pObject);
+			m_pObject = nullptr;
+		}
+	}
+
+	T* Get() const { return m_pObject; }
+	T* operator->() const { return m_pObject; }
+	T& operator*() const { return *m_pObject; }
+	explicit operator bool() const { return m_pObject != nullptr; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ObjectPool.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_set>
+#include <cstddef>
+
+template <typename T, typename AllocatorT=DefaultAllocator<T>>
+class ObjectPool {
+	static std::mutex mtx;
+	// Signalled when an object is released or the capacity is raised.
+	static std::condition_variable m_Available;
+	static std::vector<T*> m_PooledObjects;
+	static std::vector<T*> m_FreeObjects;
+	static size_t m_Capacity;
+	static AllocatorT m_Allocator;
+
+#ifdef POOL_CHECK_RELEASE
+	// Objects that are handed out. Used to catch double release.
+	static std::unordered_set<const T*> m_Outstanding;
+#endif
+
+	// Must be called with the lock held. Returns nullptr if the pool is exhausted.
+	static T* TryAcquireLocked() {
+		T *pObj{};
+		if (!m_FreeObjects.empty()) {
+			pObj = m_FreeObjects.back();
+			m_FreeObjects.pop_back();
+		} else if (m_Capacity == 0 || m_PooledObjects.size() < m_Capacity) {
+			std::cout << "[POOL] Creating a new object.\n";
+			pObj = m_Allocator();
+			m_PooledObjects.push_back(pObj);
+		} else {
+			return nullptr;
+		}
+#ifdef POOL_CHECK_RELEASE
+		m_Outstanding.insert(pObj);
+#endif
+		return pObj;
+	}
+public:
+	using Ptr = PooledPtr<T, ObjectPool>;
+
+	// 0 means unbounded. Objects already created are never deleted by lowering it.
+	static void SetCapacity(size_t capacity) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Capacity = capacity;
+		}
+		m_Available.notify_all();
+	}
+
+	// Creates objects until the pool holds at least minSize of them (within the capacity).
+	static void Prewarm(size_t minSize) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (m_Capacity != 0 && minSize > m_Capacity) {
+			minSize = m_Capacity;
+		}
+		if (m_PooledObjects.size() < minSize) {
+			std::cout << "[POOL] Prewarming " << minSize - m_PooledObjects.size() << " objects.\n";
+		}
+		while (m_PooledObjects.size() < minSize) {
+			auto pObj = m_Allocator();
+			m_PooledObjects.push_back(pObj);
+			m_FreeObjects.push_back(pObj);
+		}
+	}
+
+	// Blocks until an object is available.
+	static T* Acquire() {
+		std::unique_lock<std::mutex> lock(mtx);
+		T *pObj{};
+		m_Available.wait(lock, [&pObj]() { return (pObj = TryAcquireLocked()) != nullptr; });
+		return pObj;
+	}
+
+	// Returns nullptr if no object became available within timeout.
+	template <typename Rep, typename Period>
+	static T* Acquire(const std::chrono::duration<Rep, Period> &timeout) {
+		std::unique_lock<std::mutex> lock(mtx);
+		T *pObj{};
+		m_Available.wait_for(lock, timeout, [&pObj]() { return (pObj = TryAcquireLocked()) != nullptr; });
+		return pObj;
+	}
+
+	// Returns nullptr if the pool is exhausted.
+	static T* TryAcquire() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return TryAcquireLocked();
+	}
+
+	static Ptr AcquirePtr() {
+		return Ptr{Acquire()};
+	}
+
+	static void Release(T *pObj) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+#ifdef POOL_CHECK_RELEASE
+			if (m_Outstanding.erase(pObj) == 0) {
+				std::cout << "[POOL] Releasing an object which is not in use : " << pObj << "\n";
+				return;
+			}
+#endif
+			m_FreeObjects.push_back(pObj);
+		}
+		m_Available.notify_one();
+	}
+
+	static long InUse() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return m_PooledObjects.size() - m_FreeObjects.size();
+	}
+
+	static long Free() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return m_FreeObjects.size();
+	}
+
+	// Call it after all the other threads using the pool have finished.
+	static void Destroy() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (m_FreeObjects.size() != m_PooledObjects.size()) {
+			std::cout << "[WARNING] Deleting objects still in use.\n";
+		}
+		std::cout << "[POOL] Deleting " << m_PooledObjects.size() << " objects.\n";
+		for (auto pObj : m_PooledObjects) {
+			m_Allocator(pObj);
+		}
+		m_Allocator.Reset();
+		m_PooledObjects.clear();
+		m_FreeObjects.clear();
+#ifdef POOL_CHECK_RELEASE
+		m_Outstanding.clear();
+#endif
+	}
+};
+
+
+
+template <typename T, typename A>
+std::mutex ObjectPool<T, A>::mtx;
+
+template <typename T, typename A>
+std::condition_variable ObjectPool<T, A>::m_Available;
+
+template <typename T, typename A>
+std::vector<T*> ObjectPool<T, A>::m_PooledObjects;
+
+template <typename T, typename A>
+std::vector<T*> ObjectPool<T, A>::m_FreeObjects;
+
+template <typename T, typename A>
+size_t ObjectPool<T, A>::m_Capacity{0};
+
+template <typename T, typename A>
+A ObjectPool<T, A>::m_Allocator;
+
+#ifdef POOL_CHECK_RELEASE
+template <typename T, typename A>
+std::unordered_set<const T*> ObjectPool<T, A>::m_Outstanding;
+#endif
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+using IntPool = ObjectPool<int>;
+using namespace std::chrono_literals;
+
+// Holds an object for a while. With capacity 2 the other workers have to wait.
+void Worker(int id) {
+	auto p = IntPool::AcquirePtr();
+	*p = id;
+	std::cout << "Worker " << id << " got an object\n";
+	std::this_thread::sleep_for(100ms);
+}
+
+int main() {
+	IntPool::SetCapacity(2);
+	IntPool::Prewarm(2);
+
+	std::thread t1(Worker, 1);
+	std::thread t2(Worker, 2);
+	std::thread t3(Worker, 3);
+	std::thread t4(Worker, 4);
+	t1.join();
+	t2.join();
+	t3.join();
+	t4.join();
+
+	auto p1 = IntPool::TryAcquire();
+	auto p2 = IntPool::TryAcquire();
+	if (!IntPool::TryAcquire()) {
+		std::cout << "TryAcquire() : pool is exhausted\n";
+	}
+	if (!IntPool::Acquire(50ms)) {
+		std::cout << "Acquire(50ms) : timed out\n";
+	}
+
+	// Releasing on another thread wakes up the blocked Acquire().
+	std::thread releaser([p1]() {
+		std::this_thread::sleep_for(50ms);
+		IntPool::Release(p1);
+	});
+	auto p3 = IntPool::Acquire();
+	std::cout << "Acquire() : got the object released by the other thread\n";
+	releaser.join();
+
+	IntPool::Release(p2);
+	IntPool::Release(p3);
+
+	std::cout << "InUse : " << IntPool::InUse() << "   Free : " << IntPool::Free() << std::endl;
+
+	IntPool::Destroy();
+
+	return 0;
+}
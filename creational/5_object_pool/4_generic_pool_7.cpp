@@ -0,0 +1,441 @@
+/*
+	Shooting actors game
+
+	The pool of 4_generic_pool_2 prints InUse and Free on every Acquire() and Release().
+	Writing to std::cout on every call is slow, and a line of text per call is no help
+	when we have to decide how big a pool should be.
+
+	So the pool now keeps metrics instead. They are cheap to update :
+	 - Counters that change on every call (acquires, releases, object lifetimes) are kept
+	   in the per-thread cache of 4_generic_pool_3. Only the owner thread writes them.
+	 - Counters of the slow path (misses i.e. allocator calls, refills, flushes, time spent
+	   waiting for the lock) are updated while the lock is held anyway.
+	Stats() adds up all the counters and returns a PoolStats snapshot, which can be
+	written as text or as JSON for the dashboards. Rates are the counters divided by
+	the time since the program started (m_Start is set during static initialisation).
+
+	HighWater is the largest InUse seen. It is sampled on the slow path, so it may be
+	lower than the real peak by at most 2 * BatchSize objects per thread.
+
+	Lifetimes (time between acquire and release) are recorded for objects acquired through
+	PooledPtr, which remembers when the object was acquired. They are kept in a histogram
+	with power of two buckets : bucket i counts lifetimes in [2^(i-1), 2^i) microseconds.
+*/
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Allocator.h
+//////////////////////////////////////////////////
+template <typename T>
+class DefaultAllocator {
+public:
+	T* operator()() {
+		return new T{};
+	}
+
+	void operator()(T* p){
+		delete p;
+	}
+
+	// to reset the state of the allocator when you call Destory() on object pool.
+	void Reset() {
+
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// PooledPtr.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <chrono>
+
+template <typename T, typename PoolT>
+class PooledPtr {
+	T *m_pObject{};
+	std::chrono::steady_clock::time_point m_AcquiredAt{};
+public:
+	PooledPtr() = default;
+	explicit PooledPtr(T *pObj) : m_pObject{pObj}, m_AcquiredAt{std::chrono::steady_clock::now()} {}
+
+	PooledPtr(const PooledPtr&) = delete;
+	PooledPtr& operator=(const PooledPtr&) = delete;
+
+	PooledPtr(PooledPtr &&other) noexcept : m_pObject{other.m_pObject}, m_AcquiredAt{other.m_AcquiredAt} {
+		other.m_pObject = nullptr;
+	}
+	PooledPtr& operator=(PooledPtr &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			m_pObject = other.m_pObject;
+			m_AcquiredAt = other.m_AcquiredAt;
+			other.m_pObject = nullptr;
+		}
+		return *this;
+	}
+
+	~PooledPtr() {
+		Reset();
+	}
+
+	// Gives the object back to the pool now.
+	void Reset() {
+		if (m_pObject) {
+			PoolT::Release(m_pObject, std::chrono::steady_clock::now() - m_AcquiredAt);
+			m_pObject = nullptr;
+		}
+	}
+
+	T* Get() const { return m_pObject; }
+	T* operator->() const { return m_pObject; }
+	T& operator*() const { return *m_pObject; }
+	explicit operator bool() const { return m_pObject != nullptr; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// PoolStats.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+struct PoolStats {
+	static constexpr size_t LifetimeBuckets = 24;
+
+	double m_Seconds{};
+	uint64_t m_Acquires{};
+	uint64_t m_Releases{};
+	uint64_t m_Misses{};
+	uint64_t m_Refills{};
+	uint64_t m_Flushes{};
+	long m_InUse{};
+	long m_Free{};
+	long m_HighWater{};
+	double m_LockWaitMs{};
+	uint64_t m_Lifetimes[LifetimeBuckets]{};
+
+	double Rate(uint64_t count) const {
+		return m_Seconds > 0 ? count / m_Seconds : 0;
+	}
+	// Fraction of the acquires that had to call the allocator.
+	double MissRate() const {
+		return m_Acquires ? double(m_Misses) / m_Acquires : 0;
+	}
+
+	void ToText(std::ostream &out) const {
+		out << "InUse : " << m_InUse << "   Free : " << m_Free << "  HighWater : " << m_HighWater << "\n";
+		out << "Acquires : " << m_Acquires << " (" << Rate(m_Acquires) << "/s)"
+			<< "   Releases : " << m_Releases << " (" << Rate(m_Releases) << "/s)\n";
+		out << "Misses : " << m_Misses << " (" << MissRate() * 100 << "%)"
+			<< "   Refills : " << m_Refills << "   Flushes : " << m_Flushes << "\n";
+		out << "Lock wait : " << m_LockWaitMs << " ms\n";
+		out << "Lifetimes :\n";
+		for (size_t i = 0; i < LifetimeBuckets; ++i) {
+			if (m_Lifetimes[i]) {
+				out << "  < " << (1ull << i) << " us : " << m_Lifetimes[i] << "\n";
+			}
+		}
+	}
+
+	void ToJson(std::ostream &out) const {
+		out << "{\"seconds\":" << m_Seconds
+			<< ",\"acquires\":" << m_Acquires
+			<< ",\"releases\":" << m_Releases
+			<< ",\"misses\":" << m_Misses
+			<< ",\"refills\":" << m_Refills
+			<< ",\"flushes\":" << m_Flushes
+			<< ",\"in_use\":" << m_InUse
+			<< ",\"free\":" << m_Free
+			<< ",\"high_water\":" << m_HighWater
+			<< ",\"lock_wait_ms\":" << m_LockWaitMs
+			<< ",\"lifetime_us_log2\":[";
+		for (size_t i = 0; i < LifetimeBuckets; ++i) {
+			out << (i ? "," : "") << m_Lifetimes[i];
+		}
+		out << "]}\n";
+	}
+};
+
+constexpr size_t PoolStats::LifetimeBuckets;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ObjectPool.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+template <typename T, typename AllocatorT=DefaultAllocator<T>, size_t BatchSize=8>
+class ObjectPool {
+	using Clock = std::chrono::steady_clock;
+
+	// Magazine owned by a single thread.
+	// The counters are written only by the owner thread but are read
+	// by Stats() on other threads, hence they are atomics.
+	struct ThreadCache {
+		T *m_pObjects[2 * BatchSize];
+		std::atomic<size_t> m_Count{0};
+		std::atomic<uint64_t> m_Acquired{0};
+		std::atomic<uint64_t> m_Released{0};
+		std::atomic<uint64_t> m_LockWaitNs{0};
+		std::atomic<uint64_t> m_Lifetimes[PoolStats::LifetimeBuckets]{};
+
+		ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Caches.push_back(this);
+		}
+		// Thread is exiting. Give the cached objects and the counters back to the global pool.
+		~ThreadCache() {
+			std::lock_guard<std::mutex> lock(mtx);
+			size_t count = m_Count.load(std::memory_order_relaxed);
+			m_FreeObjects.insert(end(m_FreeObjects), m_pObjects, m_pObjects + count);
+			AddTo(m_Retired);
+			m_Caches.erase(std::find(begin(m_Caches), end(m_Caches), this));
+		}
+
+		void AddTo(PoolStats &stats) const {
+			stats.m_Acquires += m_Acquired.load(std::memory_order_relaxed);
+			stats.m_Releases += m_Released.load(std::memory_order_relaxed);
+			stats.m_LockWaitMs += m_LockWaitNs.load(std::memory_order_relaxed) / 1e6;
+			for (size_t i = 0; i < PoolStats::LifetimeBuckets; ++i) {
+				stats.m_Lifetimes[i] += m_Lifetimes[i].load(std::memory_order_relaxed);
+			}
+		}
+	};
+
+	// Protects everything below. Taken only on the slow path.
+	static std::mutex mtx;
+	static std::vector<T*> m_PooledObjects;
+	static std::vector<T*> m_FreeObjects;
+	static std::vector<ThreadCache*> m_Caches;
+	// Counters of the threads that have already exited.
+	static PoolStats m_Retired;
+	static uint64_t m_Misses;
+	static uint64_t m_Refills;
+	static uint64_t m_Flushes;
+	static long m_HighWater;
+	static Clock::time_point m_Start;
+	static AllocatorT m_Allocator;
+
+	static thread_local ThreadCache m_Cache;
+
+	// Only the owner thread writes to its counters, so no read-modify-write is needed.
+	static void Bump(std::atomic<uint64_t> &counter, uint64_t by = 1) {
+		counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+	}
+
+	// Locks mtx and records how long the caller waited for it.
+	static std::unique_lock<std::mutex> Lock(ThreadCache &cache) {
+		auto start = Clock::now();
+		std::unique_lock<std::mutex> lock(mtx);
+		Bump(cache.m_LockWaitNs, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+		return lock;
+	}
+
+	// Must be called with the lock held.
+	static long InUseLocked() {
+		PoolStats stats = m_Retired;
+		for (auto pCache : m_Caches) {
+			pCache->AddTo(stats);
+		}
+		return static_cast<long>(stats.m_Acquires - stats.m_Releases);
+	}
+
+	// Must be called with the lock held.
+	static void SampleHighWater() {
+		m_HighWater = std::max(m_HighWater, InUseLocked());
+	}
+
+	// Cache is empty. Move a batch from the global pool, creating new objects if needed.
+	static void Refill(ThreadCache &cache) {
+		auto lock = Lock(cache);
+		++m_Refills;
+		size_t count{0};
+		while (count < BatchSize && !m_FreeObjects.empty()) {
+			cache.m_pObjects[count++] = m_FreeObjects.back();
+			m_FreeObjects.pop_back();
+		}
+		m_Misses += BatchSize - count;
+		while (count < BatchSize) {
+			auto pObj = m_Allocator();
+			m_PooledObjects.push_back(pObj);
+			cache.m_pObjects[count++] = pObj;
+		}
+		cache.m_Count.store(count, std::memory_order_relaxed);
+		SampleHighWater();
+	}
+
+	// Cache is full. Move the older half back to the global pool.
+	static void Flush(ThreadCache &cache) {
+		auto lock = Lock(cache);
+		++m_Flushes;
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + BatchSize);
+		std::copy(cache.m_pObjects + BatchSize, cache.m_pObjects + 2 * BatchSize, cache.m_pObjects);
+		cache.m_Count.store(BatchSize, std::memory_order_relaxed);
+		SampleHighWater();
+	}
+public:
+	using Ptr = PooledPtr<T, ObjectPool>;
+
+	static T* Acquire() {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 0) {
+			Refill(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed) - 1;
+		cache.m_Count.store(count, std::memory_order_relaxed);
+		Bump(cache.m_Acquired);
+		return cache.m_pObjects[count];
+	}
+
+	static Ptr AcquirePtr() {
+		return Ptr{Acquire()};
+	}
+
+	static void Release(T *pObj) {
+		auto &cache = m_Cache;
+		if (cache.m_Count.load(std::memory_order_relaxed) == 2 * BatchSize) {
+			Flush(cache);
+		}
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		cache.m_pObjects[count] = pObj;
+		cache.m_Count.store(count + 1, std::memory_order_relaxed);
+		Bump(cache.m_Released);
+	}
+
+	// Also records how long the object was in use.
+	static void Release(T *pObj, Clock::duration lifetime) {
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(lifetime).count();
+		size_t bucket{0};
+		while (us > 0 && bucket < PoolStats::LifetimeBuckets - 1) {
+			us >>= 1;
+			++bucket;
+		}
+		Bump(m_Cache.m_Lifetimes[bucket]);
+		Release(pObj);
+	}
+
+	// Adds up the counters of all the threads.
+	static PoolStats Stats() {
+		std::lock_guard<std::mutex> lock(mtx);
+		PoolStats stats = m_Retired;
+		long free = m_FreeObjects.size();
+		for (auto pCache : m_Caches) {
+			pCache->AddTo(stats);
+			free += pCache->m_Count.load(std::memory_order_relaxed);
+		}
+		stats.m_Seconds = std::chrono::duration<double>(Clock::now() - m_Start).count();
+		stats.m_Misses = m_Misses;
+		stats.m_Refills = m_Refills;
+		stats.m_Flushes = m_Flushes;
+		stats.m_InUse = static_cast<long>(stats.m_Acquires - stats.m_Releases);
+		stats.m_Free = free;
+		stats.m_HighWater = std::max(m_HighWater, stats.m_InUse);
+		return stats;
+	}
+
+	// Call it after all the other threads using the pool have finished.
+	static void Destroy() {
+		// Touch the cache before locking, its constructor takes the lock.
+		auto &cache = m_Cache;
+		std::lock_guard<std::mutex> lock(mtx);
+		size_t count = cache.m_Count.load(std::memory_order_relaxed);
+		m_FreeObjects.insert(end(m_FreeObjects), cache.m_pObjects, cache.m_pObjects + count);
+		cache.m_Count.store(0, std::memory_order_relaxed);
+		if (m_FreeObjects.size() != m_PooledObjects.size()) {
+			std::cout << "[WARNING] Deleting objects still in use.\n";
+		}
+		for (auto pObj : m_PooledObjects) {
+			m_Allocator(pObj);
+		}
+		m_Allocator.Reset();
+		m_PooledObjects.clear();
+		m_FreeObjects.clear();
+	}
+};
+
+
+
+template <typename T, typename A, size_t B>
+std::mutex ObjectPool<T, A, B>::mtx;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_PooledObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<T*> ObjectPool<T, A, B>::m_FreeObjects;
+
+template <typename T, typename A, size_t B>
+std::vector<typename ObjectPool<T, A, B>::ThreadCache*> ObjectPool<T, A, B>::m_Caches;
+
+template <typename T, typename A, size_t B>
+PoolStats ObjectPool<T, A, B>::m_Retired;
+
+template <typename T, typename A, size_t B>
+uint64_t ObjectPool<T, A, B>::m_Misses{0};
+template <typename T, typename A, size_t B>
+uint64_t ObjectPool<T, A, B>::m_Refills{0};
+template <typename T, typename A, size_t B>
+uint64_t ObjectPool<T, A, B>::m_Flushes{0};
+template <typename T, typename A, size_t B>
+long ObjectPool<T, A, B>::m_HighWater{0};
+
+template <typename T, typename A, size_t B>
+std::chrono::steady_clock::time_point ObjectPool<T, A, B>::m_Start{std::chrono::steady_clock::now()};
+
+template <typename T, typename A, size_t B>
+A ObjectPool<T, A, B>::m_Allocator;
+
+template <typename T, typename A, size_t B>
+thread_local typename ObjectPool<T, A, B>::ThreadCache ObjectPool<T, A, B>::m_Cache;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+using IntPool = ObjectPool<int>;
+
+// Each thread keeps 20 objects alive for a short while, over and over.
+void Churn() {
+	IntPool::Ptr objects[20];
+	for (int round = 0; round < 1000; ++round) {
+		for (auto &p : objects) {
+			p = IntPool::AcquirePtr();
+			*p = round;
+		}
+		for (auto &p : objects) {
+			p.Reset();
+		}
+	}
+}
+
+int main() {
+	std::thread t1(Churn);
+	std::thread t2(Churn);
+	std::thread t3(Churn);
+
+	auto p1 = IntPool::AcquirePtr();
+	using namespace std::chrono_literals;
+	std::this_thread::sleep_for(10ms);
+	p1.Reset();
+
+	t1.join();
+	t2.join();
+	t3.join();
+
+	auto stats = IntPool::Stats();
+	stats.ToText(std::cout);
+	stats.ToJson(std::cout);
+
+	IntPool::Destroy();
+
+	return 0;
+}
@@ -0,0 +1,484 @@
+/*
+	Pooling heavyweight resources
+
+	So far the pool assumed an object can be reused as it is. That is fine for missiles,
+	but not for resources like 1 MiB I/O buffers or database connections.
+	 - A buffer returned to the pool still holds the data of its last user.
+	 - A connection may have an open transaction, or the server may have closed it
+	   while it was lying in the pool.
+	 - An idle pool of such objects keeps holding memory and sockets forever.
+	AllocatorT::Reset() does not help, it applies to the whole pool.
+
+	So the pool takes another strategy => PolicyT. It is called for every object :
+	 - OnAcquire(T&)  prepares the object before it is handed out.
+	 - OnRelease(T&)  clears the object's state when it comes back (e.g. rolls back a
+	                  transaction).
+	 - IsValid(const T&) is checked on release and again on acquire. A broken object is
+	   deleted instead of being handed out, and the pool creates a fresh one.
+
+	SetIdleTimeout() enables idle eviction. Free objects are kept in the order they were
+	released and reused newest first. So the oldest ones are at the front, and the objects
+	that stayed unused for longer than the timeout are deleted. This happens on every
+	Acquire() and Release(), or when EvictIdle() is called (e.g. from a timer).
+
+	The pool is bounded and blocking, as in 4_generic_pool_6.
+
+	The policy calls can be slow (zeroing 1 MiB, a rollback over the network), and so can
+	creating and deleting the objects. None of them is made with the lock held : the lock
+	only moves pointers between the lists, so the other threads are not held up.
+	 - Release() clears and checks the object first, then puts it in the free list.
+	 - Acquire() takes an object (or a slot for a new one) under the lock, then creates,
+	   checks and prepares it without the lock.
+	 - The evicted and broken objects are collected under the lock and deleted after it.
+	So PolicyT and AllocatorT are called from several threads at once, on different objects.
+*/
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Allocator.h
+//////////////////////////////////////////////////
+template <typename T>
+class DefaultAllocator {
+public:
+	T* operator()() {
+		return new T{};
+	}
+
+	void operator()(T* p){
+		delete p;
+	}
+
+	// to reset the state of the allocator when you call Destory() on object pool.
+	void Reset() {
+
+	}
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Policy.h
+//////////////////////////////////////////////////
+// Reuses the objects as they are.
+template <typename T>
+class DefaultPolicy {
+public:
+	void OnAcquire(T&) {}
+	void OnRelease(T&) {}
+	bool IsValid(const T&) const { return true; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// PooledPtr.h
+//////////////////////////////////////////////////
+// #pragma once
+template <typename T, typename PoolT>
+class PooledPtr {
+	T *m_pObject{};
+public:
+	PooledPtr() = default;
+	explicit PooledPtr(T *pObj) : m_pObject{pObj} {}
+
+	PooledPtr(const PooledPtr&) = delete;
+	PooledPtr& operator=(const PooledPtr&) = delete;
+
+	PooledPtr(PooledPtr &&other) noexcept : m_pObject{other.m_pObject} {
+		other.m_pObject = nullptr;
+	}
+	PooledPtr& operator=(PooledPtr &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			m_pObject = other.m_pObject;
+			other.m_pObject = nullptr;
+		}
+		return *this;
+	}
+
+	~PooledPtr() {
+		Reset();
+	}
+
+	// Gives the object back to the pool now.
+	void Reset() {
+		if (m_pObject) {
+			PoolT::Release(m_pObject);
+			m_pObject = nullptr;
+		}
+	}
+
+	T* Get() const { return m_pObject; }
+	T* operator->() const { return m_pObject; }
+	T& operator*() const { return *m_pObject; }
+	explicit operator bool() const { return m_pObject != nullptr; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// ObjectPool.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+
+template <typename T, typename AllocatorT=DefaultAllocator<T>, typename PolicyT=DefaultPolicy<T>>
+class ObjectPool {
+	using Clock = std::chrono::steady_clock;
+	struct FreeObject {
+		T *m_pObject{};
+		Clock::time_point m_ReleasedAt{};
+	};
+
+	static std::mutex mtx;
+	// Signalled when an object is released, deleted or the capacity is raised.
+	static std::condition_variable m_Available;
+	static std::vector<T*> m_PooledObjects;
+	// Oldest at the front, newest at the back.
+	static std::deque<FreeObject> m_FreeObjects;
+	// Objects being created outside the lock. They count against the capacity.
+	static size_t m_Creating;
+	static size_t m_Capacity;
+	// Zero means objects are never evicted.
+	static Clock::duration m_IdleTimeout;
+	static AllocatorT m_Allocator;
+	static PolicyT m_Policy;
+
+	enum class Take { None, Free, New };
+
+	// Must be called with the lock held. The object is deleted later, without the lock.
+	static void UnlinkLocked(T *pObj) {
+		m_PooledObjects.erase(std::find(begin(m_PooledObjects), end(m_PooledObjects), pObj));
+	}
+
+	// Must be called with the lock held. Moves the idle objects to evicted.
+	static void EvictIdleLocked(std::vector<T*> &evicted) {
+		if (m_IdleTimeout == Clock::duration::zero()) {
+			return;
+		}
+		auto now = Clock::now();
+		while (!m_FreeObjects.empty() && now - m_FreeObjects.front().m_ReleasedAt > m_IdleTimeout) {
+			UnlinkLocked(m_FreeObjects.front().m_pObject);
+			evicted.push_back(m_FreeObjects.front().m_pObject);
+			m_FreeObjects.pop_front();
+		}
+	}
+
+	// Must be called with the lock held. Takes the newest free object, or reserves a slot
+	// for a new one. Returns Take::None if the pool is exhausted.
+	static Take TakeLocked(T *&pObj, std::vector<T*> &evicted) {
+		EvictIdleLocked(evicted);
+		if (!m_FreeObjects.empty()) {
+			pObj = m_FreeObjects.back().m_pObject;
+			m_FreeObjects.pop_back();
+			return Take::Free;
+		}
+		if (m_Capacity == 0 || m_PooledObjects.size() + m_Creating < m_Capacity) {
+			++m_Creating;
+			return Take::New;
+		}
+		return Take::None;
+	}
+
+	static void DeleteEvicted(const std::vector<T*> &evicted) {
+		for (auto pObj : evicted) {
+			std::cout << "[POOL] Evicting an idle object.\n";
+			m_Allocator(pObj);
+		}
+		if (!evicted.empty()) {
+			m_Available.notify_all();
+		}
+	}
+
+	// Called without the lock : creating, checking and preparing an object may be slow.
+	// Returns nullptr if the object taken was broken.
+	static T* Prepare(Take take, T *pObj) {
+		if (take == Take::New) {
+			std::cout << "[POOL] Creating a new object.\n";
+			pObj = m_Allocator();
+			std::lock_guard<std::mutex> lock(mtx);
+			--m_Creating;
+			m_PooledObjects.push_back(pObj);
+		}
+		else if (!m_Policy.IsValid(*pObj)) {
+			std::cout << "[POOL] Discarding a broken object.\n";
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				UnlinkLocked(pObj);
+			}
+			m_Allocator(pObj);
+			m_Available.notify_one();
+			return nullptr;
+		}
+		m_Policy.OnAcquire(*pObj);
+		return pObj;
+	}
+
+	// wait(lock, ready) waits like the condition variable until ready() returns true.
+	// Broken objects are deleted and another one is taken.
+	template <typename WaitFn>
+	static T* AcquireWith(WaitFn wait) {
+		while (true) {
+			T *pObj{};
+			Take take{Take::None};
+			std::vector<T*> evicted;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				wait(lock, [&]() { return (take = TakeLocked(pObj, evicted)) != Take::None; });
+			}
+			DeleteEvicted(evicted);
+			if (take == Take::None) {
+				return nullptr;
+			}
+			if ((pObj = Prepare(take, pObj)) != nullptr) {
+				return pObj;
+			}
+		}
+	}
+public:
+	using Ptr = PooledPtr<T, ObjectPool>;
+
+	// 0 means unbounded. Objects already created are never deleted by lowering it.
+	static void SetCapacity(size_t capacity) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			m_Capacity = capacity;
+		}
+		m_Available.notify_all();
+	}
+
+	// Free objects unused for longer than timeout are deleted. Zero disables eviction.
+	template <typename Rep, typename Period>
+	static void SetIdleTimeout(const std::chrono::duration<Rep, Period> &timeout) {
+		std::lock_guard<std::mutex> lock(mtx);
+		m_IdleTimeout = std::chrono::duration_cast<Clock::duration>(timeout);
+	}
+
+	static void EvictIdle() {
+		std::vector<T*> evicted;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			EvictIdleLocked(evicted);
+		}
+		DeleteEvicted(evicted);
+	}
+
+	// Blocks until an object is available.
+	static T* Acquire() {
+		return AcquireWith([](std::unique_lock<std::mutex> &lock, const auto &ready) {
+			m_Available.wait(lock, ready);
+		});
+	}
+
+	// Returns nullptr if no object became available within timeout.
+	template <typename Rep, typename Period>
+	static T* Acquire(const std::chrono::duration<Rep, Period> &timeout) {
+		auto deadline = Clock::now() + timeout;
+		return AcquireWith([deadline](std::unique_lock<std::mutex> &lock, const auto &ready) {
+			m_Available.wait_until(lock, deadline, ready);
+		});
+	}
+
+	// Returns nullptr if the pool is exhausted.
+	static T* TryAcquire() {
+		return AcquireWith([](std::unique_lock<std::mutex> &, const auto &ready) {
+			ready();
+		});
+	}
+
+	static Ptr AcquirePtr() {
+		return Ptr{Acquire()};
+	}
+
+	static void Release(T *pObj) {
+		// The object is not in the free list yet, no other thread can touch it.
+		m_Policy.OnRelease(*pObj);
+		bool valid = m_Policy.IsValid(*pObj);
+		std::vector<T*> evicted;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (valid) {
+				m_FreeObjects.push_back({pObj, Clock::now()});
+			} else {
+				UnlinkLocked(pObj);
+			}
+			EvictIdleLocked(evicted);
+		}
+		// Either an object or a slot for a new one is available now.
+		m_Available.notify_one();
+		if (!valid) {
+			std::cout << "[POOL] Discarding a broken object.\n";
+			m_Allocator(pObj);
+		}
+		DeleteEvicted(evicted);
+	}
+
+	static long InUse() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return m_PooledObjects.size() - m_FreeObjects.size();
+	}
+
+	static long Free() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return m_FreeObjects.size();
+	}
+
+	// Call it after all the other threads using the pool have finished.
+	static void Destroy() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (m_FreeObjects.size() != m_PooledObjects.size()) {
+			std::cout << "[WARNING] Deleting objects still in use.\n";
+		}
+		std::cout << "[POOL] Deleting " << m_PooledObjects.size() << " objects.\n";
+		for (auto pObj : m_PooledObjects) {
+			m_Allocator(pObj);
+		}
+		m_Allocator.Reset();
+		m_PooledObjects.clear();
+		m_FreeObjects.clear();
+	}
+};
+
+
+
+template <typename T, typename A, typename P>
+std::mutex ObjectPool<T, A, P>::mtx;
+
+template <typename T, typename A, typename P>
+std::condition_variable ObjectPool<T, A, P>::m_Available;
+
+template <typename T, typename A, typename P>
+std::vector<T*> ObjectPool<T, A, P>::m_PooledObjects;
+
+template <typename T, typename A, typename P>
+std::deque<typename ObjectPool<T, A, P>::FreeObject> ObjectPool<T, A, P>::m_FreeObjects;
+
+template <typename T, typename A, typename P>
+size_t ObjectPool<T, A, P>::m_Creating{0};
+
+template <typename T, typename A, typename P>
+size_t ObjectPool<T, A, P>::m_Capacity{0};
+
+template <typename T, typename A, typename P>
+std::chrono::steady_clock::duration ObjectPool<T, A, P>::m_IdleTimeout{};
+
+template <typename T, typename A, typename P>
+A ObjectPool<T, A, P>::m_Allocator;
+
+template <typename T, typename A, typename P>
+P ObjectPool<T, A, P>::m_Policy;
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Buffer.h
+//////////////////////////////////////////////////
+// #pragma once
+struct Buffer {
+	static constexpr size_t Size = 1 << 20;
+	std::vector<char> m_Data = std::vector<char>(Size);
+	size_t m_Used{};
+};
+
+// Previous user's data must not leak to the next one.
+class BufferPolicy {
+public:
+	void OnAcquire(Buffer&) {}
+	void OnRelease(Buffer &b) {
+		std::fill(begin(b.m_Data), begin(b.m_Data) + b.m_Used, 0);
+		b.m_Used = 0;
+	}
+	bool IsValid(const Buffer &b) const { return b.m_Data.size() == Buffer::Size; }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Connection.h
+//////////////////////////////////////////////////
+// #pragma once
+#include <string>
+
+// Pretends to be a connection to a database server.
+class Connection {
+	static int m_NextId;
+	int m_Id{++m_NextId};
+	bool m_IsOpen{true};
+	bool m_InTransaction{};
+public:
+	Connection() { std::cout << "+++ Connection " << m_Id << " opened\n"; }
+	~Connection() { std::cout << "~~~ Connection " << m_Id << " closed\n"; }
+	int Id() const { return m_Id; }
+	bool IsOpen() const { return m_IsOpen; }
+	bool InTransaction() const { return m_InTransaction; }
+	void Begin() { m_InTransaction = true; }
+	void Rollback() {
+		std::cout << "Connection " << m_Id << " : rollback\n";
+		m_InTransaction = false;
+	}
+	// e.g. the server timed out the connection.
+	void Drop() { m_IsOpen = false; }
+	void Ping() {}
+};
+int Connection::m_NextId{0};
+
+class ConnectionPolicy {
+public:
+	void OnAcquire(Connection &c) { c.Ping(); }
+	// Never hand out a connection with a transaction left open by its last user.
+	void OnRelease(Connection &c) {
+		if (c.IsOpen() && c.InTransaction()) {
+			c.Rollback();
+		}
+	}
+	bool IsValid(const Connection &c) const { return c.IsOpen(); }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+using BufferPool = ObjectPool<Buffer, DefaultAllocator<Buffer>, BufferPolicy>;
+using ConnectionPool = ObjectPool<Connection, DefaultAllocator<Connection>, ConnectionPolicy>;
+using namespace std::chrono_literals;
+
+int main() {
+	{
+		auto b = BufferPool::AcquirePtr();
+		b->m_Data[0] = 'x';
+		b->m_Used = 1;
+	}
+	{
+		auto b = BufferPool::AcquirePtr();
+		std::cout << "Reused buffer starts with " << int(b->m_Data[0]) << "\n";
+	}
+	BufferPool::Destroy();
+
+	ConnectionPool::SetCapacity(2);
+	ConnectionPool::SetIdleTimeout(50ms);
+	{
+		auto c1 = ConnectionPool::AcquirePtr();
+		auto c2 = ConnectionPool::AcquirePtr();
+		// The user forgets to commit.
+		c1->Begin();
+		// The server drops this one while it is in use.
+		c2->Drop();
+	}
+	std::cout << "InUse : " << ConnectionPool::InUse() << "   Free : " << ConnectionPool::Free() << std::endl;
+	{
+		auto c = ConnectionPool::AcquirePtr();
+		std::cout << "Got connection " << c->Id() << ", in transaction : " << c->InTransaction() << "\n";
+	}
+
+	std::this_thread::sleep_for(100ms);
+	ConnectionPool::EvictIdle();
+	std::cout << "InUse : " << ConnectionPool::InUse() << "   Free : " << ConnectionPool::Free() << std::endl;
+
+	ConnectionPool::Destroy();
+
+	return 0;
+}
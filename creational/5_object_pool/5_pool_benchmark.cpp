@@ -0,0 +1,335 @@
+/*
+	Do the pools actually beat plain new and delete?
+
+	This benchmark runs the same workloads against
+	 - new/delete                  the system allocator
+	 - ObjectPool (locked)         4_generic_pool_2
+	 - ObjectPool (thread cache)   4_generic_pool_7
+	 - MissilePool                 2_missile_game_2
+	 - ActorPool                   3_multiple_actors_3 (typed API)
+
+	Workloads :
+	 - churn           one thread acquires 16 objects and releases them, over and over.
+	 - churn MT        the same on every hardware thread at once.
+	 - prod/cons       one thread acquires and hands the objects over a queue to another
+	                   thread which releases them (cross-thread release).
+	 - burst           acquire 4096 objects at once, then release them all.
+
+	Every workload runs twice. The first run is not timed per operation and gives ops/sec.
+	The second run times every single Acquire and Release and gives the latency
+	percentiles. Those include the cost of reading the clock (printed at the start).
+
+	Notes :
+	 - The examples are included as they are, each in its own namespace.
+	 - MissilePool and ActorPool are not threadsafe. ObjectPool (locked) is not either:
+	   its Release() walks the vector without the lock while Acquire() may grow it.
+	   These are skipped in the multi-threaded workloads.
+	 - Several pools print on every call. std::cout is redirected to a null buffer while
+	   the benchmark runs, but the formatting is still paid for and shows in the results.
+
+	Build it with optimisations : make 5_pool_benchmark
+*/
+
+// The examples below are included in namespaces. Their standard headers must
+// be included first, at global scope.
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#define main example_main
+
+namespace locked {
+#include "4_generic_pool_2.cpp"
+}
+
+namespace cached {
+#include "4_generic_pool_7.cpp"
+}
+
+namespace missiles {
+#include "2_missile_game_2.cpp"
+}
+
+namespace actors {
+#include "3_multiple_actors_3.cpp"
+}
+
+#undef main
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Adapters
+//////////////////////////////////////////////////
+// Gives all the pools the same interface.
+// Each adapter has Name(), ThreadSafe, a Handle type, Acquire() and Release(Handle).
+
+// Same size as a small game object.
+struct Payload {
+	float m_Data[16]{};
+};
+
+struct NewDeleteAdapter {
+	using Handle = Payload*;
+	static const char* Name() { return "new/delete"; }
+	static constexpr bool ThreadSafe = true;
+	static Handle Acquire() { return new Payload{}; }
+	static void Release(Handle h) { delete h; }
+};
+
+struct LockedPoolAdapter {
+	using Pool = locked::ObjectPool<Payload>;
+	using Handle = Payload*;
+	static const char* Name() { return "ObjectPool (locked)"; }
+	static constexpr bool ThreadSafe = false;
+	static Handle Acquire() { return Pool::Acquire(); }
+	static void Release(Handle h) { Pool::Release(h); }
+};
+
+struct CachedPoolAdapter {
+	using Pool = cached::ObjectPool<Payload>;
+	using Handle = Payload*;
+	static const char* Name() { return "ObjectPool (thread cache)"; }
+	static constexpr bool ThreadSafe = true;
+	static Handle Acquire() { return Pool::Acquire(); }
+	static void Release(Handle h) { Pool::Release(h); }
+};
+
+struct MissilePoolAdapter {
+	using Handle = missiles::MissilePtr;
+	static const char* Name() { return "MissilePool"; }
+	static constexpr bool ThreadSafe = false;
+	static Handle Acquire() { return missiles::MissilePool::AcquireMissile(); }
+	static void Release(const Handle &h) { missiles::MissilePool::ReleaseMissile(h); }
+};
+
+struct ActorPoolAdapter {
+	using Handle = std::shared_ptr<actors::Missile>;
+	static const char* Name() { return "ActorPool"; }
+	static constexpr bool ThreadSafe = false;
+	static Handle Acquire() { return actors::ActorPool::AcquireActor<actors::Missile>(); }
+	static void Release(const Handle &h) { actors::ActorPool::ReleaseActor(h); }
+};
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Timers
+//////////////////////////////////////////////////
+using Clock = std::chrono::steady_clock;
+
+// Used for the throughput runs.
+struct NoTimer {
+	int Start() { return 0; }
+	void Stop(int) {}
+};
+
+// Used for the latency runs. Keeps the duration of every operation.
+class SampleTimer {
+	std::vector<uint32_t> m_Samples;
+public:
+	Clock::time_point Start() { return Clock::now(); }
+	void Stop(Clock::time_point start) {
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+		m_Samples.push_back(static_cast<uint32_t>(ns));
+	}
+	void Merge(const SampleTimer &other) {
+		m_Samples.insert(end(m_Samples), begin(other.m_Samples), end(other.m_Samples));
+	}
+	// p in [0, 1]
+	uint32_t Percentile(double p) {
+		if (m_Samples.empty()) {
+			return 0;
+		}
+		size_t index = static_cast<size_t>(p * (m_Samples.size() - 1));
+		std::nth_element(begin(m_Samples), begin(m_Samples) + index, end(m_Samples));
+		return m_Samples[index];
+	}
+};
+
+void Merge(NoTimer&, const NoTimer&) {}
+void Merge(SampleTimer &to, const SampleTimer &from) { to.Merge(from); }
+
+
+//////////////////////////////////////////////////
+/////////////////////////// Workloads
+//////////////////////////////////////////////////
+// Each workload returns the number of operations (acquires + releases) it did.
+constexpr size_t ChurnOps = 1 << 20;
+constexpr size_t Held = 16;
+constexpr size_t BurstSize = 4096;
+constexpr size_t Bursts = 16;
+
+template <typename AdapterT, typename TimerT>
+void ChurnLoop(size_t ops, TimerT &timer) {
+	typename AdapterT::Handle held[Held];
+	for (size_t done = 0; done < ops; done += 2 * Held) {
+		for (auto &h : held) {
+			auto t = timer.Start();
+			h = AdapterT::Acquire();
+			timer.Stop(t);
+		}
+		for (auto &h : held) {
+			auto t = timer.Start();
+			AdapterT::Release(h);
+			timer.Stop(t);
+		}
+	}
+}
+
+template <typename AdapterT, typename TimerT>
+size_t Churn(TimerT &timer) {
+	ChurnLoop<AdapterT>(ChurnOps, timer);
+	return ChurnOps;
+}
+
+size_t ThreadCount() {
+	return std::max(2u, std::thread::hardware_concurrency());
+}
+
+template <typename AdapterT, typename TimerT>
+size_t ChurnMT(TimerT &timer) {
+	size_t threads = ThreadCount();
+	std::vector<TimerT> timers(threads);
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threads; ++i) {
+		workers.emplace_back([&timers, i, threads]() { ChurnLoop<AdapterT>(ChurnOps / threads, timers[i]); });
+	}
+	for (auto &w : workers) {
+		w.join();
+	}
+	for (auto &t : timers) {
+		Merge(timer, t);
+	}
+	return ChurnOps;
+}
+
+template <typename AdapterT, typename TimerT>
+size_t ProducerConsumer(TimerT &timer) {
+	const size_t items = ChurnOps / 2;
+	std::mutex mtx;
+	std::condition_variable changed;
+	std::deque<typename AdapterT::Handle> queue;
+	TimerT consumerTimer;
+
+	std::thread consumer([&]() {
+		for (size_t i = 0; i < items; ++i) {
+			std::unique_lock<std::mutex> lock(mtx);
+			changed.wait(lock, [&queue]() { return !queue.empty(); });
+			auto h = std::move(queue.front());
+			queue.pop_front();
+			lock.unlock();
+			changed.notify_one();
+			auto t = consumerTimer.Start();
+			AdapterT::Release(h);
+			consumerTimer.Stop(t);
+		}
+	});
+	for (size_t i = 0; i < items; ++i) {
+		auto t = timer.Start();
+		auto h = AdapterT::Acquire();
+		timer.Stop(t);
+		std::unique_lock<std::mutex> lock(mtx);
+		// Bounded queue, so the producer cannot run far ahead.
+		changed.wait(lock, [&queue]() { return queue.size() < 1024; });
+		queue.push_back(std::move(h));
+		lock.unlock();
+		changed.notify_one();
+	}
+	consumer.join();
+	Merge(timer, consumerTimer);
+	return 2 * items;
+}
+
+template <typename AdapterT, typename TimerT>
+size_t Burst(TimerT &timer) {
+	std::vector<typename AdapterT::Handle> held(BurstSize);
+	for (size_t b = 0; b < Bursts; ++b) {
+		for (auto &h : held) {
+			auto t = timer.Start();
+			h = AdapterT::Acquire();
+			timer.Stop(t);
+		}
+		for (auto &h : held) {
+			auto t = timer.Start();
+			AdapterT::Release(h);
+			timer.Stop(t);
+		}
+	}
+	return 2 * BurstSize * Bursts;
+}
+
+
+
+//////////////////////////////////////////////////
+/////////////////////////// main.cpp
+//////////////////////////////////////////////////
+// Swallows the output of the pools while the workloads run.
+class NullBuffer : public std::streambuf {
+protected:
+	int overflow(int c) override { return c; }
+};
+
+NullBuffer nullBuffer;
+
+template <size_t (*Run)(NoTimer&), size_t (*RunTimed)(SampleTimer&)>
+void Report(const char *workload, const char *pool) {
+	auto *coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+	NoTimer noTimer;
+	auto start = Clock::now();
+	size_t ops = Run(noTimer);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	SampleTimer timer;
+	RunTimed(timer);
+
+	std::cout.rdbuf(coutBuffer);
+	std::printf("%-10s %-26s %12.0f %8u %8u %8u\n", workload, pool, ops / seconds,
+		timer.Percentile(0.5), timer.Percentile(0.99), timer.Percentile(0.999));
+}
+
+template <typename AdapterT>
+void RunAll() {
+	Report<Churn<AdapterT, NoTimer>, Churn<AdapterT, SampleTimer>>("churn", AdapterT::Name());
+	if (AdapterT::ThreadSafe) {
+		Report<ChurnMT<AdapterT, NoTimer>, ChurnMT<AdapterT, SampleTimer>>("churn MT", AdapterT::Name());
+		Report<ProducerConsumer<AdapterT, NoTimer>, ProducerConsumer<AdapterT, SampleTimer>>("prod/cons", AdapterT::Name());
+	}
+	Report<Burst<AdapterT, NoTimer>, Burst<AdapterT, SampleTimer>>("burst", AdapterT::Name());
+}
+
+int main() {
+	SampleTimer overhead;
+	for (int i = 0; i < 100000; ++i) {
+		overhead.Stop(overhead.Start());
+	}
+	std::printf("Threads : %zu   Clock overhead (p50) : %u ns\n\n", ThreadCount(), overhead.Percentile(0.5));
+	std::printf("%-10s %-26s %12s %8s %8s %8s\n", "workload", "pool", "ops/sec", "p50 ns", "p99 ns", "p99.9 ns");
+
+	RunAll<NewDeleteAdapter>();
+	RunAll<LockedPoolAdapter>();
+	RunAll<CachedPoolAdapter>();
+	RunAll<MissilePoolAdapter>();
+	RunAll<ActorPoolAdapter>();
+
+	// Silences the pools for good, also their destructors at exit.
+	std::cout.setstate(std::ios::badbit);
+	locked::ObjectPool<Payload>::Destroy();
+	cached::ObjectPool<Payload>::Destroy();
+
+	return 0;
+}